@@ -173,6 +173,7 @@ void appBoardInit(struct Board *board)
 
   board->event.ampRetries = 0;
   board->event.codecRetries = 0;
+  board->event.metadata = false;
   board->event.mount = false;
   board->event.seeded = false;
   board->event.volume = false;
@@ -192,17 +193,26 @@ void appBoardInit(struct Board *board)
 
   /* Initialize player instance */
   if (!playerInit(&board->player, board->audio.rx, board->audio.tx,
-      I2S_BUFFER_COUNT, I2S_RX_BUFFER_LENGTH, I2S_TX_BUFFER_LENGTH, TRACK_COUNT,
-      rxBuffers, txBuffers, trackBuffers, rand))
+      I2S_BUFFER_COUNT, I2S_RX_BUFFER_LENGTH, I2S_TX_BUFFER_LENGTH,
+      PCM_BUFFER_LENGTH, TRACK_COUNT, 0, rxBuffers, pcmBuffer, trackBuffers,
+      NULL, rand))
   {
     panic(board, INIT_PLAYER);
   }
 
+  playerSetStatsTimer(&board->player, board->debug.chrono);
+  playerSetLocationTable(&board->player, trackLocations, TRACK_COUNT);
+  playerSetProbeBuffer(&board->player, probeBuffer);
+#ifdef CONFIG_ENABLE_METADATA
+  metadataTableInit(&board->metadata, metadataEntries, TRACK_COUNT,
+      metadataPool, METADATA_POOL_LENGTH);
+  playerSetMetadataTable(&board->player, &board->metadata);
+#endif
   playerShuffleControl(&board->player, true);
+  timerEnable(board->debug.chrono);
 
 #ifdef ENABLE_DBG
   debugTraceInit(board->system.serial, board->debug.chrono);
-  timerEnable(board->debug.chrono);
 #endif
 }
 /*----------------------------------------------------------------------------*/
@@ -20,6 +20,7 @@ struct Board
   struct ButtonPackage buttonPackage;
   struct ChronoPackage chronoPackage;
   struct CodecPackage codecPackage;
+  struct MetadataTable metadata;
   struct Player player;
 
   struct
@@ -32,6 +33,8 @@ struct Board
   struct
   {
     struct FsHandle *handle;
+    /* Direct access to the volume for the audio data */
+    struct FatVolume volume;
   } fs;
 
   struct
@@ -65,6 +68,7 @@ struct Board
     uint8_t ampRetries;
     uint8_t codecRetries;
 
+    bool metadata;
     bool mount;
     bool seeded;
     bool volume;
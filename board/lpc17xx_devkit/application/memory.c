@@ -8,16 +8,52 @@
 #include "player.h"
 /*----------------------------------------------------------------------------*/
 typedef uint8_t I2SRxBuffer[I2S_RX_BUFFER_LENGTH];
-typedef uint8_t I2STxBuffer[I2S_TX_BUFFER_LENGTH];
+
+/*
+ * The ring should hold all transmit requests queued to the I2S and one decoded
+ * chunk, both of them grow with the output sample width.
+ */
+static_assert(PCM_BUFFER_LENGTH >= I2S_BUFFER_COUNT * I2S_TX_BUFFER_LENGTH
+    + DECODE_CHUNK_LENGTH, "PCM buffer is too small for the output format");
+static_assert(I2S_TX_BUFFER_LENGTH % PCM_FRAME_SIZE == 0,
+    "Transmit buffer length should be a multiple of the frame size");
+static_assert(PCM_BUFFER_LENGTH % I2S_TX_BUFFER_LENGTH == 0,
+    "PCM buffer length should be a multiple of the transmit buffer length");
 /*----------------------------------------------------------------------------*/
 /* Total: 6144 bytes */
 static I2SRxBuffer rxBuffersData[I2S_BUFFER_COUNT];
 void *rxBuffers = rxBuffersData;
 /*----------------------------------------------------------------------------*/
-/* Total: 13824 bytes */
-[[gnu::section(".sram1")]] static I2STxBuffer txBuffersData[I2S_BUFFER_COUNT];
-void *txBuffers = txBuffersData;
+/* Total: 11520 bytes */
+[[gnu::section(".sram1")]] static uint8_t pcmBufferData[PCM_BUFFER_LENGTH];
+void *pcmBuffer = pcmBufferData;
+/*----------------------------------------------------------------------------*/
+/* Total: 4096 bytes, both AHB banks are full */
+static uint32_t probeBufferData[PLAYER_BUFFER_LENGTH / sizeof(uint32_t)];
+void *probeBuffer = probeBufferData;
 /*----------------------------------------------------------------------------*/
 /* Total: 8192 bytes */
 [[gnu::section(".sram2")]] static FilePath trackBuffersData[TRACK_COUNT];
 void *trackBuffers = trackBuffersData;
+/*----------------------------------------------------------------------------*/
+/* Total: 1024 bytes */
+static struct FatLocation trackLocationsData[TRACK_COUNT];
+void *trackLocations = trackLocationsData;
+/*----------------------------------------------------------------------------*/
+/*
+ * Total: 1024 bytes. Kept in the PCM bank, SRAM2 is shared with the heap
+ * which holds the player and the decoder state.
+ */
+[[gnu::section(".sram1")]] static uint32_t readAheadBufferData[READ_AHEAD_LENGTH
+    / sizeof(uint32_t)];
+void *readAheadBuffer = readAheadBufferData;
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+/* Total: 2560 bytes */
+[[gnu::section(".sram1")]] static struct TrackMetadata
+    metadataEntriesData[TRACK_COUNT];
+void *metadataEntries = metadataEntriesData;
+
+[[gnu::section(".sram1")]] static char metadataPoolData[METADATA_POOL_LENGTH];
+void *metadataPool = metadataPoolData;
+#endif
@@ -11,11 +11,19 @@
 /*----------------------------------------------------------------------------*/
 #define I2S_BUFFER_COUNT      3
 #define I2S_RX_BUFFER_LENGTH  2048
-#define I2S_TX_BUFFER_LENGTH  4608
+#define I2S_TX_BUFFER_LENGTH  2304
+#define PCM_BUFFER_LENGTH     11520
 #define TRACK_COUNT           128
+#define METADATA_POOL_LENGTH  1024
+#define READ_AHEAD_LENGTH     1024
 
 extern void *trackBuffers;
+extern void *trackLocations;
+extern void *metadataEntries;
+extern void *metadataPool;
 extern void *rxBuffers;
-extern void *txBuffers;
+extern void *pcmBuffer;
+extern void *probeBuffer;
+extern void *readAheadBuffer;
 /*----------------------------------------------------------------------------*/
 #endif /* BOARD_LPC17XX_DEVKIT_APPLICATION_MEMORY_H_ */
@@ -7,6 +7,7 @@
 #include "amplifier.h"
 #include "board.h"
 #include "interface_proxy.h"
+#include "memory.h"
 #include "partitions.h"
 #include "player.h"
 #include "tasks.h"
@@ -23,6 +24,9 @@
 #include <stdio.h>
 /*----------------------------------------------------------------------------*/
 #define BUS_MAX_RETRIES 100
+
+/* Card transfer timeout in milliseconds */
+#define CARD_TIMEOUT 500
 /*----------------------------------------------------------------------------*/
 static void onBusError(void *, void *);
 static void onBusIdle(void *, void *);
@@ -32,11 +36,15 @@ static void onCardUnmounted(void *);
 static void onConversionCompleted(void *);
 static void onGuardTimerEvent(void *);
 static void onMountTimerEvent(void *);
-static void onPlayerFormatChanged(void *, uint32_t, uint8_t);
+static void onPlayerFormatChanged(void *, const struct PcmFormat *);
 static void onPlayerStateChanged(void *, enum PlayerState);
+static void startMetadataReading(struct Board *);
 
 static void buttonCheckTask(void *);
 static void guardCheckTask(void *);
+#ifdef CONFIG_ENABLE_METADATA
+static void metadataTask(void *);
+#endif
 static void mountTask(void *);
 static void playNextTask(void *);
 static void playPauseTask(void *);
@@ -135,7 +143,11 @@ static void onCardMounted(void *argument)
   timerDisable(board->chronoPackage.mountTimer);
   pinSet(board->indication.green);
 
+  if (fatVolumeInit(&board->fs.volume, board->memory.wrapper))
+    playerSetVolume(&board->player, &board->fs.volume);
+
   playerScanFiles(&board->player, board->fs.handle);
+  startMetadataReading(board);
 
   debugTrace("Card mounted, tracks %lu",
       (unsigned long)playerGetTrackCount(&board->player));
@@ -193,16 +205,19 @@ static void onMountTimerEvent(void *argument)
   }
 }
 /*----------------------------------------------------------------------------*/
-static void onPlayerFormatChanged(void *argument, uint32_t rate,
-    [[maybe_unused]] uint8_t channels)
+static void onPlayerFormatChanged(void *argument,
+    const struct PcmFormat *format)
 {
   struct Board * const board = argument;
+  uint32_t rate = format->rate;
 
+  /* Sample width is fixed at build time and is configured during startup */
   ifSetParam(board->audio.i2s, IF_RATE, &rate);
   codecSetSampleRate(board->codecPackage.codec, rate);
 
-  debugTrace("Player rate %lu channels %lu",
-      (unsigned long)rate, (unsigned long)channels);
+  debugTrace("Player rate %lu channels %lu width %lu",
+      (unsigned long)format->rate, (unsigned long)format->channels,
+      (unsigned long)format->width);
 }
 /*----------------------------------------------------------------------------*/
 static void onPlayerStateChanged(void *argument, enum PlayerState state)
@@ -224,6 +239,18 @@ static void onPlayerStateChanged(void *argument, enum PlayerState state)
       name != NULL ? name : ""
   );
 
+#  ifdef CONFIG_ENABLE_METADATA
+  const char * const title = playerGetTrackTag(&board->player, METADATA_TITLE);
+  const char * const artist = playerGetTrackTag(&board->player,
+      METADATA_ARTIST);
+
+  if (state == PLAYER_PLAYING && (title != NULL || artist != NULL))
+  {
+    debugTrace("Player title \"%s\" artist \"%s\"",
+        title != NULL ? title : "", artist != NULL ? artist : "");
+  }
+#  endif
+
   board->debug.state = state;
   debugLedsUpdate(board);
 #endif
@@ -245,6 +272,7 @@ static void onPlayerStateChanged(void *argument, enum PlayerState state)
       ampReset(board->codecPackage.amp, AMP_GAIN_MIN, false);
       pinReset(board->indication.blue);
       pinReset(board->indication.red);
+      startMetadataReading(board);
       break;
 
     case PLAYER_ERROR:
@@ -256,6 +284,20 @@ static void onPlayerStateChanged(void *argument, enum PlayerState state)
   }
 }
 /*----------------------------------------------------------------------------*/
+static void startMetadataReading(struct Board *board)
+{
+#ifdef CONFIG_ENABLE_METADATA
+  /* Only one metadata task may be in the work queue at a time */
+  if (!board->event.metadata)
+  {
+    if (wqAdd(WQ_DEFAULT, metadataTask, board) == E_OK)
+      board->event.metadata = true;
+  }
+#else
+  (void)board;
+#endif
+}
+/*----------------------------------------------------------------------------*/
 static void buttonCheckTask(void *argument)
 {
   static const uint8_t buttonDebounceThreshold = 3;
@@ -301,6 +343,20 @@ static void guardCheckTask(void *argument)
   }
 }
 /*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+static void metadataTask(void *argument)
+{
+  struct Board * const board = argument;
+
+  /* Tracks are processed one by one, other tasks are executed in between */
+  if (!playerReadMetadata(&board->player)
+      || wqAdd(WQ_DEFAULT, metadataTask, argument) != E_OK)
+  {
+    board->event.metadata = false;
+  }
+}
+#endif
+/*----------------------------------------------------------------------------*/
 static void mountTask(void *argument)
 {
   struct Board * const board = argument;
@@ -317,8 +373,13 @@ static void mountTask(void *argument)
     {
       ifSetParam(board->memory.card, IF_BLOCKING, NULL);
 
+      /* Next card block is loaded while the current one is decoded */
       struct InterfaceProxyConfig wrapperConfig = {
-          .pipe = board->memory.card
+          .pipe = board->memory.card,
+          .buffer = readAheadBuffer,
+          .length = READ_AHEAD_LENGTH,
+          .timer = board->debug.chrono,
+          .timeout = CARD_TIMEOUT
       };
       board->memory.wrapper = init(InterfaceProxy, &wrapperConfig);
 
@@ -6,6 +6,7 @@
 
 #include "amplifier.h"
 #include "board_shared.h"
+#include "pcm_convert.h"
 #include <dpm/audio/tlv320aic3x.h>
 #include <dpm/button.h>
 #include <halm/core/cortex/systick.h>
@@ -122,7 +123,11 @@ struct Interface *boardMakeI2S(void)
   static const struct I2SDmaConfig i2sConfig = {
       .size = 2,
       .rate = 44100,
+#if PCM_OUTPUT_WIDTH == 32
+      .width = I2S_WIDTH_32,
+#else
       .width = I2S_WIDTH_16,
+#endif
       .tx = {
           .sda = PIN(0, 9),
           .sck = PIN(0, 7),
@@ -161,18 +161,29 @@ void appBoardInit(struct Board *board)
 
   board->memory.card = NULL;
   board->memory.wrapper = NULL;
+
+  /* Resume point storage is optional */
+  board->memory.eeprom = boardMakeEeprom();
+  if (board->memory.eeprom != NULL)
+    ifSetParam(board->memory.eeprom, IF_BLOCKING, NULL);
   board->memory.sdmmc = boardMakeSDMMC();
   if (board->memory.sdmmc == NULL)
     panic(board, INIT_MEMORY_SDIO);
 
   board->event.ampRetries = 0;
   board->event.codecRetries = 0;
+  board->event.metadata = false;
   board->event.mount = false;
+  board->event.resume = false;
   board->event.seeded = false;
   board->event.volume = false;
 
   board->guard.adc = false;
 
+  board->scan.direction = 0;
+  board->scan.steps = 0;
+  board->scan.pending = false;
+
   board->rng.iteration = sizeof(board->rng.seed) * 8;
   board->rng.seed = 0;
 
@@ -188,17 +199,41 @@ void appBoardInit(struct Board *board)
 
   /* Initialize player instance */
   if (!playerInit(&board->player, board->audio.rx, board->audio.tx,
-      I2S_BUFFER_COUNT, I2S_RX_BUFFER_LENGTH, I2S_TX_BUFFER_LENGTH, TRACK_COUNT,
-      rxBuffers, txBuffers, trackBuffers, rand))
+      I2S_BUFFER_COUNT, I2S_RX_BUFFER_LENGTH, I2S_TX_BUFFER_LENGTH,
+      PCM_BUFFER_LENGTH, TRACK_COUNT, OPUS_ARENA_LENGTH, rxBuffers, pcmBuffer,
+      trackBuffers, opusArena, rand))
   {
     panic(board, INIT_PLAYER);
   }
 
+  playerSetStatsTimer(&board->player, board->debug.chrono);
+  playerSetLocationTable(&board->player, trackLocations, TRACK_COUNT);
+  playerSetProbeBuffer(&board->player, probeBuffer);
+#ifdef CONFIG_ENABLE_METADATA
+  metadataTableInit(&board->metadata, metadataEntries, TRACK_COUNT,
+      metadataPool, METADATA_POOL_LENGTH);
+  playerSetMetadataTable(&board->player, &board->metadata);
+#endif
   playerShuffleControl(&board->player, true);
 
+  if (board->memory.eeprom != NULL)
+  {
+    struct ResumePoint point;
+
+    if (!resumeStorageInit(&board->resume.storage, board->memory.eeprom))
+    {
+      deinit(board->memory.eeprom);
+      board->memory.eeprom = NULL;
+    }
+    else if (resumeStorageLoad(&board->resume.storage, &point))
+    {
+      playerSetResumePoint(&board->player, &point);
+    }
+  }
+  timerEnable(board->debug.chrono);
+
 #ifdef ENABLE_DBG
   debugTraceInit(board->system.serial, board->debug.chrono);
-  timerEnable(board->debug.chrono);
 #endif
 }
 /*----------------------------------------------------------------------------*/
@@ -20,6 +20,7 @@ struct Board
   struct ButtonPackage buttonPackage;
   struct ChronoPackage chronoPackage;
   struct CodecPackage codecPackage;
+  struct MetadataTable metadata;
   struct Player player;
 
   struct
@@ -32,6 +33,8 @@ struct Board
   struct
   {
     struct FsHandle *handle;
+    /* Direct access to the volume for the audio data */
+    struct FatVolume volume;
   } fs;
 
   struct
@@ -47,10 +50,16 @@ struct Board
   struct
   {
     struct Interface *card;
+    struct Interface *eeprom;
     struct Interface *sdmmc;
     struct Interface *wrapper;
   } memory;
 
+  struct
+  {
+    struct ResumeStorage storage;
+  } resume;
+
   struct
   {
     struct Interface *serial;
@@ -63,7 +72,9 @@ struct Board
     uint8_t ampRetries;
     uint8_t codecRetries;
 
+    bool metadata;
     bool mount;
+    bool resume;
     bool seeded;
     bool volume;
   } event;
@@ -73,6 +84,16 @@ struct Board
     bool adc;
   } guard;
 
+  struct
+  {
+    /* Scan direction, zero when scanning is inactive */
+    int8_t direction;
+    /* Number of steps since the button was pressed */
+    uint8_t steps;
+    /* Scan step is in the work queue */
+    bool pending;
+  } scan;
+
   struct
   {
     unsigned int seed;
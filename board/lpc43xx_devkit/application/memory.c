@@ -4,20 +4,69 @@
  * Project is distributed under the terms of the GNU General Public License v3.0
  */
 
+#include "interface_proxy.h"
 #include "memory.h"
 #include "player.h"
 /*----------------------------------------------------------------------------*/
 typedef uint8_t I2SRxBuffer[I2S_RX_BUFFER_LENGTH];
-typedef uint8_t I2STxBuffer[I2S_TX_BUFFER_LENGTH];
+
+/*
+ * The ring should hold all transmit requests queued to the I2S and one decoded
+ * chunk, both of them grow with the output sample width.
+ */
+static_assert(PCM_BUFFER_LENGTH >= I2S_BUFFER_COUNT * I2S_TX_BUFFER_LENGTH
+    + DECODE_CHUNK_LENGTH, "PCM buffer is too small for the output format");
+static_assert(I2S_TX_BUFFER_LENGTH % PCM_FRAME_SIZE == 0,
+    "Transmit buffer length should be a multiple of the frame size");
+static_assert(PCM_BUFFER_LENGTH % I2S_TX_BUFFER_LENGTH == 0,
+    "PCM buffer length should be a multiple of the transmit buffer length");
 /*----------------------------------------------------------------------------*/
 /* Total: 13824 bytes */
 [[gnu::section(".sram4")]] static I2SRxBuffer rxBuffersData[I2S_BUFFER_COUNT];
 void *rxBuffers = rxBuffersData;
 /*----------------------------------------------------------------------------*/
+/* Total: 2048 bytes */
+[[gnu::section(".sram4")]] static uint32_t readAheadBufferData[READ_AHEAD_LENGTH
+    / sizeof(uint32_t)];
+void *readAheadBuffer = readAheadBufferData;
+/*----------------------------------------------------------------------------*/
 /* Total: 27648 bytes */
-[[gnu::section(".sram2")]] static I2STxBuffer txBuffersData[I2S_BUFFER_COUNT];
-void *txBuffers = txBuffersData;
+[[gnu::section(".sram2")]] static uint8_t pcmBufferData[PCM_BUFFER_LENGTH];
+void *pcmBuffer = pcmBufferData;
+/*----------------------------------------------------------------------------*/
+/* Total: 4096 bytes */
+static uint32_t probeBufferData[PLAYER_BUFFER_LENGTH / sizeof(uint32_t)];
+void *probeBuffer = probeBufferData;
 /*----------------------------------------------------------------------------*/
 /* Total: 16384 bytes */
 [[gnu::section(".sram3")]] static FilePath trackBuffersData[TRACK_COUNT];
 void *trackBuffers = trackBuffersData;
+/*----------------------------------------------------------------------------*/
+/* Total: 2048 bytes */
+static struct FatLocation trackLocationsData[TRACK_COUNT];
+void *trackLocations = trackLocationsData;
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+/* Total: 5120 bytes */
+[[gnu::section(".sram2")]] static struct TrackMetadata
+    metadataEntriesData[TRACK_COUNT];
+void *metadataEntries = metadataEntriesData;
+
+[[gnu::section(".sram2")]] static char metadataPoolData[METADATA_POOL_LENGTH];
+void *metadataPool = metadataPoolData;
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_OPUS
+/* Total: 32768 bytes */
+[[gnu::section(".sram0")]] static uint64_t opusArenaData[OPUS_ARENA_LENGTH
+    / sizeof(uint64_t)];
+void *opusArena = opusArenaData;
+void *sectorCache = NULL;
+#else
+void *opusArena = NULL;
+
+/* Total: 16640 bytes, SRAM0 is spare when the Opus decoder is disabled */
+[[gnu::section(".sram0")]] static uint32_t sectorCacheData[SECTOR_CACHE_SIZE
+    / sizeof(uint32_t)];
+void *sectorCache = sectorCacheData;
+#endif
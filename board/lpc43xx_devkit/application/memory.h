@@ -11,11 +11,24 @@
 /*----------------------------------------------------------------------------*/
 #define I2S_BUFFER_COUNT      3
 #define I2S_RX_BUFFER_LENGTH  4608
-#define I2S_TX_BUFFER_LENGTH  9216
+#define I2S_TX_BUFFER_LENGTH  4608
+#define PCM_BUFFER_LENGTH     27648
 #define TRACK_COUNT           256
+#define METADATA_POOL_LENGTH  2048
+#define OPUS_ARENA_LENGTH     32768
+#define READ_AHEAD_LENGTH     2048
+#define SECTOR_CACHE_LINES    32
+#define SECTOR_CACHE_SIZE     INTERFACE_PROXY_CACHE_SIZE(SECTOR_CACHE_LINES)
 
 extern void *trackBuffers;
+extern void *trackLocations;
+extern void *metadataEntries;
+extern void *metadataPool;
 extern void *rxBuffers;
-extern void *txBuffers;
+extern void *pcmBuffer;
+extern void *probeBuffer;
+extern void *opusArena;
+extern void *readAheadBuffer;
+extern void *sectorCache;
 /*----------------------------------------------------------------------------*/
 #endif /* BOARD_LPC43XX_DEVKIT_APPLICATION_MEMORY_H_ */
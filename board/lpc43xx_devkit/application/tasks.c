@@ -7,6 +7,7 @@
 #include "amplifier.h"
 #include "board.h"
 #include "interface_proxy.h"
+#include "memory.h"
 #include "partitions.h"
 #include "player.h"
 #include "tasks.h"
@@ -24,12 +25,25 @@
 #include <stdio.h>
 /*----------------------------------------------------------------------------*/
 #define BUS_MAX_RETRIES 100
+
+/* Card transfer timeout in milliseconds */
+#define CARD_TIMEOUT 500
+
+/* Scan step period in milliseconds */
+#define SCAN_PERIOD           250
+/* Initial scan step in milliseconds */
+#define SCAN_STEP             2000
+/* Step is doubled after this number of steps */
+#define SCAN_STEPS_PER_LEVEL  8
+#define SCAN_MAX_LEVEL        3
 /*----------------------------------------------------------------------------*/
 static void onBusError(void *, void *);
 static void onBusIdle(void *, void *);
+static void onButtonFastForwardPressed(void *);
 static void onButtonPlayNextPressed(void *);
 static void onButtonPlayPausePressed(void *);
 static void onButtonPlayPreviousPressed(void *);
+static void onButtonRewindPressed(void *);
 static void onButtonStopPlayingPressed(void *);
 static void onButtonSwitchShufflePressed(void *);
 static void onCardMounted(void *);
@@ -37,14 +51,25 @@ static void onCardUnmounted(void *);
 static void onConversionCompleted(void *);
 static void onGuardTimerEvent(void *);
 static void onMountTimerEvent(void *);
-static void onPlayerFormatChanged(void *, uint32_t, uint8_t);
+static void onPlayerFormatChanged(void *, const struct PcmFormat *);
 static void onPlayerStateChanged(void *, enum PlayerState);
+static void onScanTimerEvent(void *);
+static void startMetadataReading(struct Board *);
+static void startResumeSaving(struct Board *);
+static void startScanning(struct Board *, int8_t);
 
+static void fastForwardTask(void *);
 static void guardCheckTask(void *);
+#ifdef CONFIG_ENABLE_METADATA
+static void metadataTask(void *);
+#endif
 static void mountTask(void *);
 static void playNextTask(void *);
 static void playPauseTask(void *);
 static void playPreviousTask(void *);
+static void resumeSaveTask(void *);
+static void rewindTask(void *);
+static void scanStepTask(void *);
 static void seedRandomTask(void *);
 static void startupTask(void *);
 static void stopPlayingTask(void *);
@@ -119,6 +144,11 @@ static void onBusIdle(void *argument, void *device)
   }
 }
 /*----------------------------------------------------------------------------*/
+static void onButtonFastForwardPressed(void *argument)
+{
+  wqAdd(WQ_DEFAULT, fastForwardTask, argument);
+}
+/*----------------------------------------------------------------------------*/
 static void onButtonPlayNextPressed(void *argument)
 {
   wqAdd(WQ_DEFAULT, playNextTask, argument);
@@ -134,6 +164,11 @@ static void onButtonPlayPreviousPressed(void *argument)
   wqAdd(WQ_DEFAULT, playPreviousTask, argument);
 }
 /*----------------------------------------------------------------------------*/
+static void onButtonRewindPressed(void *argument)
+{
+  wqAdd(WQ_DEFAULT, rewindTask, argument);
+}
+/*----------------------------------------------------------------------------*/
 static void onButtonStopPlayingPressed(void *argument)
 {
   wqAdd(WQ_DEFAULT, stopPlayingTask, argument);
@@ -151,10 +186,20 @@ static void onCardMounted(void *argument)
   timerDisable(board->chronoPackage.mountTimer);
   pinSet(board->indication.green);
 
+  if (fatVolumeInit(&board->fs.volume, board->memory.wrapper))
+    playerSetVolume(&board->player, &board->fs.volume);
+
   playerScanFiles(&board->player, board->fs.handle);
+  startMetadataReading(board);
 
-  debugTrace("Card mounted, tracks %lu",
-      (unsigned long)playerGetTrackCount(&board->player));
+#ifdef ENABLE_DBG
+  const struct InterfaceProxyStats stats =
+      interfaceProxyGetStats(board->memory.wrapper);
+
+  debugTrace("Card mounted, tracks %lu, cache hits %lu misses %lu",
+      (unsigned long)playerGetTrackCount(&board->player),
+      (unsigned long)stats.hits, (unsigned long)stats.misses);
+#endif
 }
 /*----------------------------------------------------------------------------*/
 static void onCardUnmounted(void *argument)
@@ -226,16 +271,19 @@ static void onMountTimerEvent(void *argument)
   }
 }
 /*----------------------------------------------------------------------------*/
-static void onPlayerFormatChanged(void *argument, uint32_t rate,
-    [[maybe_unused]] uint8_t channels)
+static void onPlayerFormatChanged(void *argument,
+    const struct PcmFormat *format)
 {
   struct Board * const board = argument;
+  uint32_t rate = format->rate;
 
+  /* Sample width is fixed at build time and is configured during startup */
   ifSetParam(board->audio.i2s, IF_RATE, &rate);
   codecSetSampleRate(board->codecPackage.codec, rate);
 
-  debugTrace("Player rate %lu channels %lu",
-      (unsigned long)rate, (unsigned long)channels);
+  debugTrace("Player rate %lu channels %lu width %lu",
+      (unsigned long)format->rate, (unsigned long)format->channels,
+      (unsigned long)format->width);
 }
 /*----------------------------------------------------------------------------*/
 static void onPlayerStateChanged(void *argument, enum PlayerState state)
@@ -257,6 +305,18 @@ static void onPlayerStateChanged(void *argument, enum PlayerState state)
       name != NULL ? name : ""
   );
 
+#  ifdef CONFIG_ENABLE_METADATA
+  const char * const title = playerGetTrackTag(&board->player, METADATA_TITLE);
+  const char * const artist = playerGetTrackTag(&board->player,
+      METADATA_ARTIST);
+
+  if (state == PLAYER_PLAYING && (title != NULL || artist != NULL))
+  {
+    debugTrace("Player title \"%s\" artist \"%s\"",
+        title != NULL ? title : "", artist != NULL ? artist : "");
+  }
+#  endif
+
   board->debug.state = state;
   debugLedsUpdate(board);
 #endif
@@ -272,12 +332,15 @@ static void onPlayerStateChanged(void *argument, enum PlayerState state)
     case PLAYER_PAUSED:
       pinSet(board->indication.blue);
       pinReset(board->indication.red);
+      startResumeSaving(board);
       break;
 
     case PLAYER_STOPPED:
       ampReset(board->codecPackage.amp, AMP_GAIN_MIN, false);
       pinReset(board->indication.blue);
       pinReset(board->indication.red);
+      startResumeSaving(board);
+      startMetadataReading(board);
       break;
 
     case PLAYER_ERROR:
@@ -289,6 +352,71 @@ static void onPlayerStateChanged(void *argument, enum PlayerState state)
   }
 }
 /*----------------------------------------------------------------------------*/
+static void onScanTimerEvent(void *argument)
+{
+  struct Board * const board = argument;
+
+  /*
+   * Only one scan step may be in the work queue at a time, steps are
+   * skipped while the decoder is busy with a previous position.
+   */
+  if (!board->scan.pending)
+  {
+    if (wqAdd(WQ_DEFAULT, scanStepTask, board) == E_OK)
+      board->scan.pending = true;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void startMetadataReading(struct Board *board)
+{
+#ifdef CONFIG_ENABLE_METADATA
+  /* Only one metadata task may be in the work queue at a time */
+  if (!board->event.metadata)
+  {
+    if (wqAdd(WQ_DEFAULT, metadataTask, board) == E_OK)
+      board->event.metadata = true;
+  }
+#else
+  (void)board;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+static void startResumeSaving(struct Board *board)
+{
+  /*
+   * Resume point is saved only when the playback is paused or stopped,
+   * blocking EEPROM writes never delay the decoding of the audio stream.
+   */
+  if (board->memory.eeprom != NULL && !board->event.resume)
+  {
+    if (wqAdd(WQ_DEFAULT, resumeSaveTask, board) == E_OK)
+      board->event.resume = true;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void startScanning(struct Board *board, int8_t direction)
+{
+  if (playerGetDuration(&board->player) == 0)
+    return;
+
+  board->scan.direction = direction;
+  board->scan.steps = 0;
+  scanStepTask(board);
+
+  if (board->scan.direction != 0)
+  {
+    timerSetOverflow(board->chronoPackage.scanTimer,
+        timerGetFrequency(board->chronoPackage.scanTimer) * SCAN_PERIOD / 1000);
+    timerSetValue(board->chronoPackage.scanTimer, 0);
+    timerEnable(board->chronoPackage.scanTimer);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void fastForwardTask(void *argument)
+{
+  startScanning(argument, 1);
+}
+/*----------------------------------------------------------------------------*/
 static void guardCheckTask(void *argument)
 {
   struct Board * const board = argument;
@@ -306,6 +434,20 @@ static void guardCheckTask(void *argument)
   }
 }
 /*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+static void metadataTask(void *argument)
+{
+  struct Board * const board = argument;
+
+  /* Tracks are processed one by one, other tasks are executed in between */
+  if (!playerReadMetadata(&board->player)
+      || wqAdd(WQ_DEFAULT, metadataTask, argument) != E_OK)
+  {
+    board->event.metadata = false;
+  }
+}
+#endif
+/*----------------------------------------------------------------------------*/
 static void mountTask(void *argument)
 {
   struct Board * const board = argument;
@@ -322,8 +464,18 @@ static void mountTask(void *argument)
     {
       ifSetParam(board->memory.card, IF_BLOCKING, NULL);
 
+      /*
+       * Next card block is loaded while the current one is decoded,
+       * file system metadata sectors are kept in the sector cache.
+       */
       struct InterfaceProxyConfig wrapperConfig = {
-          .pipe = board->memory.card
+          .pipe = board->memory.card,
+          .buffer = readAheadBuffer,
+          .length = READ_AHEAD_LENGTH,
+          .cache = sectorCache,
+          .cacheSize = SECTOR_CACHE_SIZE,
+          .timer = board->debug.chrono,
+          .timeout = CARD_TIMEOUT
       };
       board->memory.wrapper = init(InterfaceProxy, &wrapperConfig);
 
@@ -382,6 +534,67 @@ static void playPreviousTask(void *argument)
   playerPlayPrevious(&board->player);
 }
 /*----------------------------------------------------------------------------*/
+static void resumeSaveTask(void *argument)
+{
+  struct Board * const board = argument;
+  struct ResumePoint point;
+
+  board->event.resume = false;
+
+  /* Storage skips writing when the point has not changed */
+  if (board->memory.eeprom != NULL
+      && playerGetResumePoint(&board->player, &point))
+  {
+    resumeStorageSave(&board->resume.storage, &point);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void rewindTask(void *argument)
+{
+  startScanning(argument, -1);
+}
+/*----------------------------------------------------------------------------*/
+static void scanStepTask(void *argument)
+{
+  struct Board * const board = argument;
+
+  board->scan.pending = false;
+
+  if (board->scan.direction == 0)
+    return;
+
+  struct ButtonComplex * const button = board->scan.direction > 0 ?
+      board->buttonPackage.buttons[3] : board->buttonPackage.buttons[0];
+  const uint32_t duration = playerGetDuration(&board->player);
+  const uint32_t position = playerGetPosition(&board->player);
+  const unsigned int level =
+      MIN(board->scan.steps / SCAN_STEPS_PER_LEVEL, SCAN_MAX_LEVEL);
+  const uint32_t step = (uint32_t)SCAN_STEP << level;
+  bool proceed = buttonComplexIsPressed(button);
+
+  if (proceed)
+  {
+    uint32_t target;
+
+    if (board->scan.direction > 0)
+      target = position + step;
+    else
+      target = position > step ? position - step : 0;
+
+    /* Scanning is stopped at the end of the track */
+    proceed = target < duration && playerSeek(&board->player, target);
+
+    if (board->scan.steps < UINT8_MAX)
+      ++board->scan.steps;
+  }
+
+  if (!proceed)
+  {
+    timerDisable(board->chronoPackage.scanTimer);
+    board->scan.direction = 0;
+  }
+}
+/*----------------------------------------------------------------------------*/
 static void seedRandomTask(void *argument)
 {
   const struct Board * const board = argument;
@@ -413,6 +626,9 @@ static void startupTask(void *argument)
       timerGetFrequency(board->chronoPackage.mountTimer));
   timerEnable(board->chronoPackage.mountTimer);
 
+  /* Scan timer is enabled while Next or Previous button is held */
+  timerSetCallback(board->chronoPackage.scanTimer, onScanTimerEvent, board);
+
   /* 2 * 100 Hz ADC trigger rate, start ADC sampling */
   ifSetParam(board->analogPackage.adc, IF_ENABLE, NULL);
   timerSetOverflow(board->analogPackage.timer,
@@ -425,6 +641,8 @@ static void startupTask(void *argument)
   /* Connect and enable buttons */
   buttonComplexSetPressCallback(board->buttonPackage.buttons[0],
       onButtonPlayPreviousPressed, board);
+  buttonComplexSetLongPressCallback(board->buttonPackage.buttons[0],
+      onButtonRewindPressed, board);
   buttonComplexSetPressCallback(board->buttonPackage.buttons[1],
       onButtonStopPlayingPressed, board);
   buttonComplexSetLongPressCallback(board->buttonPackage.buttons[1],
@@ -433,6 +651,8 @@ static void startupTask(void *argument)
       onButtonPlayPausePressed, board);
   buttonComplexSetPressCallback(board->buttonPackage.buttons[3],
       onButtonPlayNextPressed, board);
+  buttonComplexSetLongPressCallback(board->buttonPackage.buttons[3],
+      onButtonFastForwardPressed, board);
   for (size_t i = 0; i < ARRAY_SIZE(board->buttonPackage.buttons); ++i)
     buttonComplexEnable(board->buttonPackage.buttons[i]);
 
@@ -470,7 +690,10 @@ static void switchShuffleTask(void *argument)
   playerShuffleControl(&board->player, !playerGetShuffleState(&board->player));
 
   if (board->fs.handle != NULL)
+  {
     playerScanFiles(&board->player, board->fs.handle);
+    startMetadataReading(board);
+  }
 
   if (board->fs.handle != NULL)
   {
@@ -6,6 +6,7 @@
 
 #include "amplifier.h"
 #include "board_shared.h"
+#include "pcm_convert.h"
 #include <dpm/audio/tlv320aic3x.h>
 #include <dpm/bus_handler.h>
 #include <dpm/button_complex.h>
@@ -14,6 +15,7 @@
 #include <halm/generic/timer_factory.h>
 #include <halm/platform/lpc/adc_dma.h>
 #include <halm/platform/lpc/clocking.h>
+#include <halm/platform/lpc/eeprom.h>
 #include <halm/platform/lpc/gptimer.h>
 #include <halm/platform/lpc/i2c.h>
 #include <halm/platform/lpc/i2s_dma.h>
@@ -86,6 +88,11 @@ struct Timer *boardMakeChronoTimer(void)
   return init(GpTimer, &timerConfig);
 }
 /*----------------------------------------------------------------------------*/
+struct Interface *boardMakeEeprom(void)
+{
+  return init(Eeprom, NULL);
+}
+/*----------------------------------------------------------------------------*/
 struct Timer *boardMakeLoadTimer(void)
 {
   static const struct GpTimerConfig timerConfig = {
@@ -128,7 +135,11 @@ struct Interface *boardMakeI2S(void)
   static const struct I2SDmaConfig i2sConfig = {
       .size = 2,
       .rate = 44100,
+#if PCM_OUTPUT_WIDTH == 32
+      .width = I2S_WIDTH_32,
+#else
       .width = I2S_WIDTH_16,
+#endif
       .tx = {
           .sda = PIN(PORT_7, 2),
           .sck = PIN(PORT_4, 7),
@@ -314,6 +325,10 @@ bool boardSetupChronoPackage(struct ChronoPackage *package)
   if (package->mountTimer == NULL)
     return false;
 
+  package->scanTimer = timerFactoryCreate(package->factory);
+  if (package->scanTimer == NULL)
+    return false;
+
   return true;
 }
 /*----------------------------------------------------------------------------*/
@@ -61,6 +61,7 @@ struct ChronoPackage
 
   struct Timer *guardTimer;
   struct Timer *mountTimer;
+  struct Timer *scanTimer;
 };
 
 struct CodecPackage
@@ -79,6 +80,7 @@ BEGIN_DECLS
 struct Entity *boardMakeAmp(struct Interface *, struct Timer *);
 struct Entity *boardMakeCodec(struct Interface *, struct Timer *);
 struct Timer *boardMakeChronoTimer(void);
+struct Interface *boardMakeEeprom(void);
 struct Timer *boardMakeLoadTimer(void);
 struct Interface *boardMakeI2C(void);
 struct Interface *boardMakeI2C0(void);
@@ -0,0 +1,151 @@
+/*
+ * core/adpcm.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "adpcm.h"
+#include <xcore/memory.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+#define MAX_STEP_INDEX 88
+/*----------------------------------------------------------------------------*/
+static inline int32_t decodeNibble(struct AdpcmDecoder *, unsigned int,
+    unsigned int);
+static inline PcmSample expandSample(int32_t);
+/*----------------------------------------------------------------------------*/
+static const int8_t indexTable[8] = {
+    -1, -1, -1, -1, 2, 4, 6, 8
+};
+
+static const uint16_t stepTable[MAX_STEP_INDEX + 1] = {
+    7, 8, 9, 10, 11, 12, 13, 14, 16, 17,
+    19, 21, 23, 25, 28, 31, 34, 37, 41, 45,
+    50, 55, 60, 66, 73, 80, 88, 97, 107, 118,
+    130, 143, 157, 173, 190, 209, 230, 253, 279, 307,
+    337, 371, 408, 449, 494, 544, 598, 658, 724, 796,
+    876, 963, 1060, 1166, 1282, 1411, 1552, 1707, 1878, 2066,
+    2272, 2499, 2749, 3024, 3327, 3660, 4026, 4428, 4871, 5358,
+    5894, 6484, 7132, 7845, 8630, 9493, 10442, 11487, 12635, 13899,
+    15289, 16818, 18500, 20350, 22385, 24623, 27086, 29794, 32767
+};
+/*----------------------------------------------------------------------------*/
+static inline int32_t decodeNibble(struct AdpcmDecoder *decoder,
+    unsigned int channel, unsigned int nibble)
+{
+  const int32_t step = stepTable[decoder->index[channel]];
+  int32_t difference = step >> 3;
+  int32_t predictor = decoder->predictor[channel];
+  int index = (int)decoder->index[channel] + indexTable[nibble & 7];
+
+  if (nibble & 1)
+    difference += step >> 2;
+  if (nibble & 2)
+    difference += step >> 1;
+  if (nibble & 4)
+    difference += step;
+
+  predictor += (nibble & 8) ? -difference : difference;
+
+  if (predictor > INT16_MAX)
+    predictor = INT16_MAX;
+  else if (predictor < INT16_MIN)
+    predictor = INT16_MIN;
+
+  if (index < 0)
+    index = 0;
+  else if (index > MAX_STEP_INDEX)
+    index = MAX_STEP_INDEX;
+
+  decoder->predictor[channel] = predictor;
+  decoder->index[channel] = (uint8_t)index;
+
+  return predictor;
+}
+/*----------------------------------------------------------------------------*/
+static inline PcmSample expandSample(int32_t value)
+{
+  /* Samples are aligned to the most significant bit */
+  return (PcmSample)((uint32_t)value << (PCM_OUTPUT_WIDTH - 16));
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Decodes sample groups of all channels into stereo frames in the output
+ * format, each group produces ADPCM_GROUP_SAMPLES frames.
+ */
+void adpcmDecodeGroups(struct AdpcmDecoder *decoder, void *buffer,
+    const uint8_t *input, size_t count)
+{
+  PcmSample *output = buffer;
+
+  if (decoder->channels == 1)
+  {
+    while (count--)
+    {
+      for (unsigned int i = 0; i < ADPCM_GROUP_LENGTH; ++i)
+      {
+        const unsigned int value = *input++;
+        const PcmSample a = expandSample(decodeNibble(decoder, 0, value));
+        const PcmSample b = expandSample(decodeNibble(decoder, 0, value >> 4));
+
+        output[0] = a;
+        output[1] = a;
+        output[2] = b;
+        output[3] = b;
+        output += 4;
+      }
+    }
+  }
+  else
+  {
+    while (count--)
+    {
+      /* Groups of the left and right channels are interleaved */
+      for (unsigned int channel = 0; channel < 2; ++channel)
+      {
+        PcmSample *position = output + channel;
+
+        for (unsigned int i = 0; i < ADPCM_GROUP_LENGTH; ++i)
+        {
+          const unsigned int value = *input++;
+
+          position[0] = expandSample(decodeNibble(decoder, channel, value));
+          position[2] = expandSample(decodeNibble(decoder, channel,
+              value >> 4));
+          position += 4;
+        }
+      }
+
+      output += ADPCM_GROUP_SAMPLES * 2;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Loads the initial state of each channel from the block header and writes
+ * the first frame of the block.
+ */
+bool adpcmDecodeHeader(struct AdpcmDecoder *decoder, void *buffer,
+    const uint8_t *input)
+{
+  PcmSample * const output = buffer;
+
+  for (unsigned int channel = 0; channel < decoder->channels; ++channel)
+  {
+    uint16_t predictor;
+
+    memcpy(&predictor, input, sizeof(predictor));
+
+    if (input[2] > MAX_STEP_INDEX)
+      return false;
+
+    decoder->predictor[channel] = (int16_t)fromLittleEndian16(predictor);
+    decoder->index[channel] = input[2];
+    input += ADPCM_HEADER_LENGTH;
+  }
+
+  output[0] = expandSample(decoder->predictor[0]);
+  output[1] = expandSample(decoder->predictor[decoder->channels - 1]);
+
+  return true;
+}
@@ -0,0 +1,41 @@
+/*
+ * core/adpcm.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_ADPCM_H_
+#define CORE_ADPCM_H_
+/*----------------------------------------------------------------------------*/
+#include "pcm_convert.h"
+#include <stdbool.h>
+/*----------------------------------------------------------------------------*/
+/* Length of the block header for each channel in bytes */
+#define ADPCM_HEADER_LENGTH 4
+/* Length of the sample group for each channel in bytes */
+#define ADPCM_GROUP_LENGTH  4
+/* Samples in the sample group */
+#define ADPCM_GROUP_SAMPLES 8
+
+/* State of the IMA ADPCM decoder */
+struct AdpcmDecoder
+{
+  /* Predicted sample of each channel */
+  int32_t predictor[2];
+  /* Step table index of each channel */
+  uint8_t index[2];
+  /* Channel count */
+  uint8_t channels;
+  /* Sample groups left in the current block */
+  size_t groups;
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+void adpcmDecodeGroups(struct AdpcmDecoder *, void *, const uint8_t *,
+    size_t);
+bool adpcmDecodeHeader(struct AdpcmDecoder *, void *, const uint8_t *);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_ADPCM_H_ */
@@ -0,0 +1,902 @@
+/*
+ * core/fat_extents.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "fat_extents.h"
+#include <xcore/helpers.h>
+#include <xcore/memory.h>
+#include <assert.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+#ifndef CONFIG_PATH_LENGTH
+#  define NAME_LENGTH 64
+#else
+#  define NAME_LENGTH CONFIG_PATH_LENGTH
+#endif
+
+#define ENTRY_SIZE        32
+#define SECTOR_ENTRIES    (FAT_SECTOR_SIZE / ENTRY_SIZE)
+#define LFN_ENTRY_CHARS   13
+/* Longer names do not fit in track paths and are never compared */
+#define LFN_ENTRY_COUNT \
+    ((NAME_LENGTH + LFN_ENTRY_CHARS - 1) / LFN_ENTRY_CHARS)
+
+#define FLAG_DIRECTORY    0x10
+#define FLAG_LONG_NAME    0x0F
+#define FLAG_VOLUME       0x08
+
+#define CLUSTER_MASK      0x0FFFFFFFUL
+#define CLUSTER_OFFSET    2
+/*----------------------------------------------------------------------------*/
+struct FatEntry
+{
+  struct FatLocation location;
+  uint32_t cluster;
+  uint32_t size;
+  bool directory;
+};
+/*----------------------------------------------------------------------------*/
+static uint32_t clusterToSector(const struct FatVolume *, uint32_t);
+static bool compareLongName(const uint16_t *, size_t, const char *, size_t);
+static bool compareShortName(const uint8_t *, const char *, size_t);
+static bool extendMap(struct FatVolume *, struct FatExtentMap *, uint32_t,
+    uint32_t);
+static bool findEntry(struct FatVolume *, struct FatCursor *, const char *,
+    size_t, struct FatEntry *);
+static const struct FatExtent *findExtent(const struct FatExtentMap *,
+    uint32_t);
+static bool findNode(struct FatVolume *, const char *, struct FatEntry *,
+    struct FatCursor *);
+static char foldCase(char);
+static void getEntry(const uint8_t *, struct FatEntry *);
+static uint8_t getShortNameChecksum(const uint8_t *);
+static uint16_t getWord(const uint8_t *);
+static uint32_t getLong(const uint8_t *);
+static bool isClusterValid(const struct FatVolume *, uint32_t);
+static bool readEntry(struct FatVolume *, const struct FatLocation *,
+    struct FatEntry *);
+static bool readNextCluster(struct FatVolume *, uint32_t, uint32_t *);
+static bool readSector(struct FatVolume *, uint32_t);
+static bool readSectors(struct FatVolume *, uint32_t, void *, uint32_t);
+static bool scanEntries(struct FatVolume *, struct FatCursor *, uint32_t,
+    uint32_t, uint32_t, uint32_t, const char *, size_t, struct FatEntry *);
+static bool setupMap(struct FatVolume *, const struct FatEntry *,
+    struct FatExtentMap *);
+/*----------------------------------------------------------------------------*/
+static enum Result nodeInit(void *, const void *);
+static enum Result nodeCreate(void *, const struct FsFieldDescriptor *, size_t);
+static void *nodeHead(void *);
+static void nodeFree(void *);
+static enum Result nodeLength(void *, enum FsFieldType, FsLength *);
+static enum Result nodeNext(void *);
+static enum Result nodeRead(void *, enum FsFieldType, FsLength, void *, size_t,
+    size_t *);
+static enum Result nodeRemove(void *, void *);
+static enum Result nodeWrite(void *, enum FsFieldType, FsLength, const void *,
+    size_t, size_t *);
+/*----------------------------------------------------------------------------*/
+const struct FsNodeClass * const FatExtentNode =
+    &(const struct FsNodeClass){
+    .size = sizeof(struct FatExtentNode),
+    .init = nodeInit,
+    .deinit = NULL, /* Default destructor */
+
+    .create = nodeCreate,
+    .head = nodeHead,
+    .free = nodeFree,
+    .length = nodeLength,
+    .next = nodeNext,
+    .read = nodeRead,
+    .remove = nodeRemove,
+    .write = nodeWrite
+};
+/*----------------------------------------------------------------------------*/
+static uint32_t clusterToSector(const struct FatVolume *volume,
+    uint32_t cluster)
+{
+  return volume->data + ((cluster - CLUSTER_OFFSET) << volume->shift);
+}
+/*----------------------------------------------------------------------------*/
+static bool compareLongName(const uint16_t *units, size_t count,
+    const char *name, size_t length)
+{
+  size_t position = 0;
+
+  for (size_t index = 0; index < count && units[index]; ++index)
+  {
+    uint32_t code = units[index];
+
+    if (code >= 0xD800 && code <= 0xDBFF)
+    {
+      const uint32_t low = index + 1 < count ? units[index + 1] : 0;
+
+      if (low < 0xDC00 || low > 0xDFFF)
+        return false;
+
+      code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+      ++index;
+    }
+    else if (code >= 0xDC00 && code <= 0xDFFF)
+      return false;
+
+    char sequence[4];
+    size_t width;
+
+    if (code < 0x80)
+    {
+      sequence[0] = (char)code;
+      width = 1;
+    }
+    else if (code < 0x800)
+    {
+      sequence[0] = (char)(0xC0 | (code >> 6));
+      sequence[1] = (char)(0x80 | (code & 0x3F));
+      width = 2;
+    }
+    else if (code < 0x10000)
+    {
+      sequence[0] = (char)(0xE0 | (code >> 12));
+      sequence[1] = (char)(0x80 | ((code >> 6) & 0x3F));
+      sequence[2] = (char)(0x80 | (code & 0x3F));
+      width = 3;
+    }
+    else
+    {
+      sequence[0] = (char)(0xF0 | (code >> 18));
+      sequence[1] = (char)(0x80 | ((code >> 12) & 0x3F));
+      sequence[2] = (char)(0x80 | ((code >> 6) & 0x3F));
+      sequence[3] = (char)(0x80 | (code & 0x3F));
+      width = 4;
+    }
+
+    if (length - position < width)
+      return false;
+
+    for (size_t i = 0; i < width; ++i)
+    {
+      if (foldCase(sequence[i]) != foldCase(name[position + i]))
+        return false;
+    }
+
+    position += width;
+  }
+
+  return position == length;
+}
+/*----------------------------------------------------------------------------*/
+static bool compareShortName(const uint8_t *entry, const char *name,
+    size_t length)
+{
+  char buffer[13];
+  size_t count = 0;
+
+  for (size_t index = 0; index < 8 && entry[index] != ' '; ++index)
+  {
+    /* Value 0x05 stands for the 0xE5 character at the name start */
+    buffer[count++] = (char)(!index && entry[index] == 0x05 ?
+        0xE5 : entry[index]);
+  }
+
+  if (entry[8] != ' ')
+  {
+    buffer[count++] = '.';
+
+    for (size_t index = 8; index < 11 && entry[index] != ' '; ++index)
+      buffer[count++] = (char)entry[index];
+  }
+
+  if (count != length)
+    return false;
+
+  for (size_t index = 0; index < count; ++index)
+  {
+    if (foldCase(buffer[index]) != foldCase(name[index]))
+      return false;
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool extendMap(struct FatVolume *volume, struct FatExtentMap *map,
+    uint32_t from, uint32_t to)
+{
+  const uint32_t total = (uint32_t)((map->length + FAT_SECTOR_SIZE - 1)
+      / FAT_SECTOR_SIZE);
+  const uint32_t run = 1UL << volume->shift;
+
+  /* Runs before the window are not stored, the chain is followed again */
+  if (!map->count || from < map->extents[0].offset)
+  {
+    map->count = 0;
+    map->next = map->first;
+  }
+
+  uint32_t end = map->count ? map->extents[map->count - 1].offset
+      + map->extents[map->count - 1].count : 0;
+
+  if (end >= to)
+    return true;
+
+  /* Mapping runs ahead of the reads to reduce allocation table reads */
+  const uint32_t limit = MIN(total, MAX(to, end + FAT_MAP_WINDOW));
+
+  while (end < limit)
+  {
+    if (!isClusterValid(volume, map->next))
+      return false;
+
+    const uint32_t sector = clusterToSector(volume, map->next);
+    uint32_t following = 0;
+
+    /* Map is left unchanged when the allocation table can not be read */
+    if (end + run < total && !readNextCluster(volume, map->next, &following))
+      return false;
+
+    struct FatExtent * const last = map->count ?
+        &map->extents[map->count - 1] : NULL;
+
+    if (last != NULL && last->sector + last->count == sector)
+    {
+      last->count += run;
+    }
+    else
+    {
+      if (map->count == FAT_EXTENT_COUNT)
+      {
+        size_t passed = 0;
+
+        /* Runs that end before the requested part are dropped */
+        while (passed < map->count && map->extents[passed].offset
+            + map->extents[passed].count <= from)
+        {
+          ++passed;
+        }
+
+        if (!passed)
+          return end >= to;
+
+        map->count -= passed;
+        memmove(map->extents, map->extents + passed,
+            map->count * sizeof(struct FatExtent));
+      }
+
+      map->extents[map->count++] = (struct FatExtent){
+          .offset = end,
+          .sector = sector,
+          .count = run
+      };
+    }
+
+    end += run;
+    map->next = following;
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool findEntry(struct FatVolume *volume, struct FatCursor *cursor,
+    const char *name, size_t length, struct FatEntry *result)
+{
+  const uint32_t cluster = cursor->cluster;
+  const uint32_t entry = cursor->entry;
+
+  if (scanEntries(volume, cursor, cluster, entry, 0, 0, name, length, result))
+    return true;
+
+  /* Entries before the start position are checked after the last one */
+  if (cluster != cursor->directory || entry != 0)
+  {
+    return scanEntries(volume, cursor, cursor->directory, 0, cluster, entry,
+        name, length, result);
+  }
+
+  return false;
+}
+/*----------------------------------------------------------------------------*/
+static const struct FatExtent *findExtent(const struct FatExtentMap *map,
+    uint32_t sector)
+{
+  size_t low = 0;
+  size_t high = map->count;
+
+  while (high - low > 1)
+  {
+    const size_t middle = (low + high) / 2;
+
+    if (map->extents[middle].offset <= sector)
+      low = middle;
+    else
+      high = middle;
+  }
+
+  return &map->extents[low];
+}
+/*----------------------------------------------------------------------------*/
+static bool findNode(struct FatVolume *volume, const char *path,
+    struct FatEntry *entry, struct FatCursor *cursor)
+{
+  entry->cluster = volume->root;
+  entry->size = 0;
+  entry->directory = true;
+
+  while (*path)
+  {
+    if (*path == '/')
+    {
+      ++path;
+      continue;
+    }
+
+    if (!entry->directory)
+      return false;
+
+    const char * const separator = strchr(path, '/');
+    const size_t length = separator != NULL ?
+        (size_t)(separator - path) : strlen(path);
+
+    cursor->directory = entry->cluster;
+    cursor->cluster = entry->cluster;
+    cursor->entry = 0;
+
+    if (!findEntry(volume, cursor, path, length, entry))
+      return false;
+
+    path += length;
+  }
+
+  return !entry->directory;
+}
+/*----------------------------------------------------------------------------*/
+static char foldCase(char value)
+{
+  return value >= 'a' && value <= 'z' ? (char)(value - 'a' + 'A') : value;
+}
+/*----------------------------------------------------------------------------*/
+static void getEntry(const uint8_t *entry, struct FatEntry *result)
+{
+  result->cluster = ((uint32_t)getWord(entry + 20) << 16)
+      | getWord(entry + 26);
+  result->size = getLong(entry + 28);
+  result->directory = (entry[11] & FLAG_DIRECTORY) != 0;
+}
+/*----------------------------------------------------------------------------*/
+static uint8_t getShortNameChecksum(const uint8_t *entry)
+{
+  uint8_t sum = 0;
+
+  for (size_t index = 0; index < 11; ++index)
+    sum = (uint8_t)(((sum & 1) << 7) + (sum >> 1) + entry[index]);
+
+  return sum;
+}
+/*----------------------------------------------------------------------------*/
+static uint16_t getWord(const uint8_t *data)
+{
+  uint16_t value;
+
+  memcpy(&value, data, sizeof(value));
+  return fromLittleEndian16(value);
+}
+/*----------------------------------------------------------------------------*/
+static uint32_t getLong(const uint8_t *data)
+{
+  uint32_t value;
+
+  memcpy(&value, data, sizeof(value));
+  return fromLittleEndian32(value);
+}
+/*----------------------------------------------------------------------------*/
+static bool isClusterValid(const struct FatVolume *volume, uint32_t cluster)
+{
+  return cluster >= CLUSTER_OFFSET
+      && cluster - CLUSTER_OFFSET < volume->clusters;
+}
+/*----------------------------------------------------------------------------*/
+static bool readEntry(struct FatVolume *volume,
+    const struct FatLocation *location, struct FatEntry *entry)
+{
+  if (location->sector < volume->data || location->index >= SECTOR_ENTRIES)
+    return false;
+  if (!readSector(volume, location->sector))
+    return false;
+
+  const uint8_t * const data = volume->buffer + location->index * ENTRY_SIZE;
+
+  /* Entry is checked again in case the location is outdated */
+  if (data[0] == 0x00 || data[0] == 0xE5
+      || (data[11] & 0x3F) == FLAG_LONG_NAME || (data[11] & FLAG_VOLUME))
+  {
+    return false;
+  }
+
+  getEntry(data, entry);
+  entry->location = *location;
+  return !entry->directory;
+}
+/*----------------------------------------------------------------------------*/
+static bool readNextCluster(struct FatVolume *volume, uint32_t cluster,
+    uint32_t *next)
+{
+  static const uint32_t entriesPerSector = FAT_SECTOR_SIZE / sizeof(uint32_t);
+
+  if (!readSector(volume, volume->fat + cluster / entriesPerSector))
+    return false;
+
+  *next = getLong(volume->buffer
+      + (cluster % entriesPerSector) * sizeof(uint32_t)) & CLUSTER_MASK;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readSector(struct FatVolume *volume, uint32_t sector)
+{
+  if (volume->cached == sector)
+    return true;
+
+  if (readSectors(volume, sector, volume->buffer, 1))
+  {
+    volume->cached = sector;
+    return true;
+  }
+  else
+  {
+    volume->cached = UINT32_MAX;
+    return false;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bool readSectors(struct FatVolume *volume, uint32_t sector,
+    void *buffer, uint32_t count)
+{
+  const uint64_t position = (uint64_t)sector * FAT_SECTOR_SIZE;
+  const size_t length = (size_t)count * FAT_SECTOR_SIZE;
+
+  if (ifSetParam(volume->interface, IF_POSITION_64, &position) != E_OK)
+    return false;
+
+  return ifRead(volume->interface, buffer, length) == length;
+}
+/*----------------------------------------------------------------------------*/
+static bool scanEntries(struct FatVolume *volume, struct FatCursor *cursor,
+    uint32_t cluster, uint32_t entry, uint32_t stopCluster, uint32_t stopEntry,
+    const char *name, size_t length, struct FatEntry *result)
+{
+  const uint32_t count = SECTOR_ENTRIES << volume->shift;
+  uint16_t units[LFN_ENTRY_COUNT * LFN_ENTRY_CHARS];
+  size_t unitCount = 0;
+  uint8_t checksum = 0;
+  uint8_t next = 0;
+  /* Long name entries precede the short name entry in reverse order */
+  bool present = false;
+  bool fits = false;
+
+  /* Iteration limit protects against loops in the allocation table */
+  for (uint32_t step = 0; step < volume->clusters; ++step)
+  {
+    if (!isClusterValid(volume, cluster))
+      return false;
+
+    const uint32_t first = clusterToSector(volume, cluster);
+
+    for (; entry < count; ++entry)
+    {
+      if (cluster == stopCluster && entry == stopEntry)
+        return false;
+
+      const uint32_t sector = first + entry / SECTOR_ENTRIES;
+      const size_t index = entry % SECTOR_ENTRIES;
+
+      if (!readSector(volume, sector))
+        return false;
+
+      const uint8_t * const data = volume->buffer + index * ENTRY_SIZE;
+
+      /* End of the directory */
+      if (data[0] == 0x00)
+        return false;
+
+      /* Deleted entry */
+      if (data[0] == 0xE5)
+      {
+        present = false;
+        continue;
+      }
+
+      if ((data[11] & 0x3F) == FLAG_LONG_NAME)
+      {
+        const uint8_t order = data[0] & 0x1F;
+
+        if (data[0] & 0x40)
+        {
+          present = order > 0;
+          fits = order <= LFN_ENTRY_COUNT;
+          unitCount = (size_t)order * LFN_ENTRY_CHARS;
+          checksum = data[13];
+          next = order;
+        }
+
+        if (!present || order != next || data[13] != checksum)
+        {
+          present = false;
+          continue;
+        }
+
+        if (fits)
+        {
+          static const uint8_t positions[LFN_ENTRY_CHARS] = {
+              1, 3, 5, 7, 9, 14, 16, 18, 20, 22, 24, 28, 30
+          };
+          uint16_t * const part = units + (order - 1) * LFN_ENTRY_CHARS;
+
+          for (size_t i = 0; i < LFN_ENTRY_CHARS; ++i)
+            part[i] = getWord(data + positions[i]);
+        }
+
+        --next;
+        continue;
+      }
+
+      if (data[11] & FLAG_VOLUME)
+      {
+        present = false;
+        continue;
+      }
+
+      bool match;
+
+      if (present && !next && getShortNameChecksum(data) == checksum)
+        match = fits && compareLongName(units, unitCount, name, length);
+      else
+        match = compareShortName(data, name, length);
+
+      present = false;
+
+      if (match)
+      {
+        getEntry(data, result);
+        result->location.sector = sector;
+        result->location.index = (uint16_t)index;
+
+        /* Next sibling is usually stored after this entry */
+        cursor->cluster = cluster;
+        cursor->entry = entry + 1;
+        return true;
+      }
+    }
+
+    entry = 0;
+
+    if (!readNextCluster(volume, cluster, &cluster))
+      return false;
+  }
+
+  return false;
+}
+/*----------------------------------------------------------------------------*/
+static bool setupMap(struct FatVolume *volume, const struct FatEntry *entry,
+    struct FatExtentMap *map)
+{
+  map->length = entry->size;
+  map->count = 0;
+  map->first = entry->cluster;
+  map->next = entry->cluster;
+
+  /* Only the first window is mapped, the rest is mapped while reading */
+  if (!extendMap(volume, map, 0, 1))
+  {
+    map->count = 0;
+    return false;
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeInit(void *object, const void *configBase)
+{
+  const struct FatExtentNodeConfig * const config = configBase;
+  assert(config != NULL);
+  assert(config->volume != NULL && config->location != NULL);
+
+  struct FatExtentNode * const node = object;
+  struct FatVolume * const volume = config->volume;
+
+  node->volume = volume;
+  node->map.length = 0;
+  node->map.count = 0;
+
+  /* Directories and allocation table could be changed by the file system */
+  volume->cached = UINT32_MAX;
+
+  struct FatEntry entry;
+  bool res;
+
+  ifSetParam(volume->interface, IF_ACQUIRE, NULL);
+  res = readEntry(volume, config->location, &entry) && entry.size > 0
+      && setupMap(volume, &entry, &node->map);
+  ifSetParam(volume->interface, IF_RELEASE, NULL);
+
+  return res ? E_OK : E_ENTRY;
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeCreate(void *, const struct FsFieldDescriptor *, size_t)
+{
+  return E_INVALID;
+}
+/*----------------------------------------------------------------------------*/
+static void *nodeHead(void *)
+{
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+static void nodeFree(void *object)
+{
+  deinit(object);
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeLength(void *object, enum FsFieldType type,
+    FsLength *length)
+{
+  const struct FatExtentNode * const node = object;
+
+  if (type != FS_NODE_DATA)
+    return E_INVALID;
+
+  if (length != NULL)
+    *length = node->map.length;
+  return E_OK;
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeNext(void *)
+{
+  return E_INVALID;
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeRead(void *object, enum FsFieldType type,
+    FsLength position, void *buffer, size_t length, size_t *read)
+{
+  struct FatExtentNode * const node = object;
+
+  if (type != FS_NODE_DATA)
+    return E_INVALID;
+  if (position > node->map.length)
+    return E_VALUE;
+
+  if (position == node->map.length || !length)
+  {
+    if (read != NULL)
+      *read = 0;
+    return E_OK;
+  }
+
+  return fatExtentMapRead(node->volume, &node->map, position, buffer, length,
+      read) ? E_OK : E_INTERFACE;
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeRemove(void *, void *)
+{
+  return E_INVALID;
+}
+/*----------------------------------------------------------------------------*/
+static enum Result nodeWrite(void *, enum FsFieldType, FsLength, const void *,
+    size_t, size_t *)
+{
+  return E_INVALID;
+}
+/*----------------------------------------------------------------------------*/
+bool fatExtentMapBuild(struct FatVolume *volume,
+    const struct FatLocation *location, FsLength length,
+    struct FatExtentMap *map)
+{
+  map->length = length;
+  map->count = 0;
+
+  if (!length || length > UINT32_MAX)
+    return false;
+
+  /* Directories and allocation table could be changed by the file system */
+  volume->cached = UINT32_MAX;
+
+  struct FatEntry entry;
+  bool res;
+
+  ifSetParam(volume->interface, IF_ACQUIRE, NULL);
+  res = readEntry(volume, location, &entry) && entry.size == length
+      && setupMap(volume, &entry, map);
+  ifSetParam(volume->interface, IF_RELEASE, NULL);
+
+  if (!res)
+    map->count = 0;
+  return res;
+}
+/*----------------------------------------------------------------------------*/
+bool fatExtentMapRead(struct FatVolume *volume, struct FatExtentMap *map,
+    FsLength position, void *buffer, size_t length, size_t *read)
+{
+  if (!map->count || position >= map->length)
+    return false;
+
+  if ((FsLength)length > map->length - position)
+    length = (size_t)(map->length - position);
+
+  uint8_t *output = buffer;
+  size_t left = length;
+  bool res = true;
+
+  ifSetParam(volume->interface, IF_ACQUIRE, NULL);
+
+  while (left)
+  {
+    const uint32_t index = (uint32_t)(position / FAT_SECTOR_SIZE);
+    const size_t offset = (size_t)(position % FAT_SECTOR_SIZE);
+
+    /* Parts of the chain after the mapped window are mapped on demand */
+    if (!extendMap(volume, map, index, index + 1))
+    {
+      res = false;
+      break;
+    }
+
+    const struct FatExtent * const extent = findExtent(map, index);
+    const uint32_t sector = extent->sector + (index - extent->offset);
+    size_t chunk;
+
+    /* Partial sectors and unaligned buffers are copied from the buffer */
+    if (offset || left < FAT_SECTOR_SIZE
+        || (uintptr_t)output % sizeof(uint32_t))
+    {
+      if (!readSector(volume, sector))
+      {
+        res = false;
+        break;
+      }
+
+      chunk = MIN(left, FAT_SECTOR_SIZE - offset);
+      memcpy(output, volume->buffer + offset, chunk);
+    }
+    else
+    {
+      const uint32_t count = MIN((uint32_t)(left / FAT_SECTOR_SIZE),
+          extent->offset + extent->count - index);
+
+      if (!readSectors(volume, sector, output, count))
+      {
+        res = false;
+        break;
+      }
+
+      chunk = (size_t)count * FAT_SECTOR_SIZE;
+    }
+
+    output += chunk;
+    position += chunk;
+    left -= chunk;
+  }
+
+  ifSetParam(volume->interface, IF_RELEASE, NULL);
+
+  if (res && read != NULL)
+    *read = length;
+  return res;
+}
+/*----------------------------------------------------------------------------*/
+bool fatVolumeInit(struct FatVolume *volume, struct Interface *interface)
+{
+  bool res;
+
+  volume->interface = interface;
+  volume->cached = UINT32_MAX;
+  volume->clusters = 0;
+
+  ifSetParam(volume->interface, IF_ACQUIRE, NULL);
+  res = readSector(volume, 0);
+  ifSetParam(volume->interface, IF_RELEASE, NULL);
+
+  if (!res)
+    return false;
+
+  const uint8_t * const boot = volume->buffer;
+
+  if (boot[0x01FE] != 0x55 || boot[0x01FF] != 0xAA)
+    return false;
+  if (getWord(boot + 0x0B) != FAT_SECTOR_SIZE)
+    return false;
+
+  /* Sectors per cluster, reserved sectors and number of tables */
+  const uint8_t clusterSize = boot[0x0D];
+  const uint32_t reserved = getWord(boot + 0x0E);
+  const uint32_t tables = boot[0x10];
+
+  if (!clusterSize || (clusterSize & (clusterSize - 1)) || !reserved
+      || !tables)
+  {
+    return false;
+  }
+
+  /* Only FAT32 volumes have zero in the 16-bit table size field */
+  const uint32_t tableSize = getLong(boot + 0x24);
+  uint32_t total = getWord(boot + 0x13);
+
+  if (getWord(boot + 0x16) != 0 || !tableSize)
+    return false;
+  if (!total)
+    total = getLong(boot + 0x20);
+
+  const uint64_t data = reserved + (uint64_t)tables * tableSize;
+
+  if (data >= total)
+    return false;
+
+  volume->shift = 0;
+  while ((1U << volume->shift) < clusterSize)
+    ++volume->shift;
+
+  volume->fat = reserved;
+  volume->data = (uint32_t)data;
+  volume->clusters = (total - volume->data) >> volume->shift;
+  volume->root = getLong(boot + 0x2C) & CLUSTER_MASK;
+
+  return isClusterValid(volume, volume->root);
+}
+/*----------------------------------------------------------------------------*/
+bool fatVolumeLocate(struct FatVolume *volume, const char *path,
+    struct FatLocation *location, struct FatCursor *cursor)
+{
+  /* Directories could be changed by the file system */
+  volume->cached = UINT32_MAX;
+
+  struct FatCursor position;
+  struct FatEntry entry;
+  bool res;
+
+  ifSetParam(volume->interface, IF_ACQUIRE, NULL);
+  res = findNode(volume, path, &entry, &position);
+  ifSetParam(volume->interface, IF_RELEASE, NULL);
+
+  if (res)
+    *location = entry.location;
+  else
+    location->sector = 0;
+
+  if (cursor != NULL)
+  {
+    if (res)
+      *cursor = position;
+    else
+      cursor->directory = 0;
+  }
+
+  return res;
+}
+/*----------------------------------------------------------------------------*/
+/* Directory should not be changed after the cursor was set */
+bool fatVolumeLocateSibling(struct FatVolume *volume, struct FatCursor *cursor,
+    const char *name, struct FatLocation *location)
+{
+  struct FatEntry entry;
+  bool res = false;
+
+  location->sector = 0;
+
+  if (cursor->directory == 0 || strchr(name, '/') != NULL)
+    return false;
+
+  ifSetParam(volume->interface, IF_ACQUIRE, NULL);
+
+  /* Search starts after the previous sibling and wraps around */
+  if (findEntry(volume, cursor, name, strlen(name), &entry))
+  {
+    if (!entry.directory)
+    {
+      *location = entry.location;
+      res = true;
+    }
+  }
+  else
+  {
+    cursor->directory = 0;
+  }
+
+  ifSetParam(volume->interface, IF_RELEASE, NULL);
+  return res;
+}
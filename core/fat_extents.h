@@ -0,0 +1,127 @@
+/*
+ * core/fat_extents.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_FAT_EXTENTS_H_
+#define CORE_FAT_EXTENTS_H_
+/*----------------------------------------------------------------------------*/
+#include <xcore/fs/fs.h>
+#include <xcore/interface.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+/* Maximum number of contiguous runs in the map of one file */
+#define FAT_EXTENT_COUNT  8
+#define FAT_SECTOR_SIZE   512
+/* Number of sectors mapped ahead of the reads, 128 KiB */
+#define FAT_MAP_WINDOW    256
+
+/* Run of contiguous sectors of a file */
+struct FatExtent
+{
+  /* Position in the file in sectors */
+  uint32_t offset;
+  /* Position of the first sector on the volume */
+  uint32_t sector;
+  /* Length in sectors */
+  uint32_t count;
+};
+
+/* Location of the short directory entry of a file */
+struct FatLocation
+{
+  /* Sector with the entry, zero when the location is unknown */
+  uint32_t sector;
+  /* Index of the entry in the sector */
+  uint16_t index;
+};
+
+/* Position in a directory where the search for a sibling file starts */
+struct FatCursor
+{
+  /* First cluster of the directory, zero when the cursor is not set */
+  uint32_t directory;
+  /* Cluster with the entry that follows the last found one */
+  uint32_t cluster;
+  /* Index of that entry in the cluster */
+  uint32_t entry;
+};
+
+/*
+ * Location of the file data on the volume. The cluster chain is followed
+ * lazily: the map covers a window of the file that is extended when reads
+ * reach its end, runs behind the reads are dropped when the table is full.
+ */
+struct FatExtentMap
+{
+  struct FatExtent extents[FAT_EXTENT_COUNT];
+  /* File length in bytes */
+  FsLength length;
+  /* Number of extents, zero when the map is not available */
+  size_t count;
+  /* First cluster of the file */
+  uint32_t first;
+  /* Cluster that follows the mapped part of the file */
+  uint32_t next;
+};
+
+/* Read-only access to the FAT32 volume bypassing the file system handle */
+struct FatVolume
+{
+  /* Interface of the partition */
+  struct Interface *interface;
+
+  /* First sector of the allocation table */
+  uint32_t fat;
+  /* First sector of the data region */
+  uint32_t data;
+  /* First cluster of the root directory */
+  uint32_t root;
+  /* Number of data clusters */
+  uint32_t clusters;
+  /* Base-2 logarithm of the cluster size in sectors */
+  uint8_t shift;
+
+  /* Number of the sector in the buffer */
+  uint32_t cached;
+  /* Buffer for allocation table, directory and partial data reads */
+  uint8_t buffer[FAT_SECTOR_SIZE];
+};
+
+extern const struct FsNodeClass * const FatExtentNode;
+
+struct FatExtentNodeConfig
+{
+  /** Mandatory: volume with the file. */
+  struct FatVolume *volume;
+  /** Mandatory: location of the directory entry of the file. */
+  const struct FatLocation *location;
+};
+
+/* Read-only file opened directly from its directory entry */
+struct FatExtentNode
+{
+  struct FsNode base;
+
+  struct FatVolume *volume;
+  struct FatExtentMap map;
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+bool fatExtentMapBuild(struct FatVolume *, const struct FatLocation *,
+    FsLength, struct FatExtentMap *);
+bool fatExtentMapRead(struct FatVolume *, struct FatExtentMap *, FsLength,
+    void *, size_t, size_t *);
+bool fatVolumeInit(struct FatVolume *, struct Interface *);
+bool fatVolumeLocate(struct FatVolume *, const char *, struct FatLocation *,
+    struct FatCursor *);
+bool fatVolumeLocateSibling(struct FatVolume *, struct FatCursor *,
+    const char *, struct FatLocation *);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_FAT_EXTENTS_H_ */
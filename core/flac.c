@@ -0,0 +1,834 @@
+/*
+ * core/flac.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "flac.h"
+#include <xcore/memory.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+#define MAX_HEADER_LENGTH 16
+
+enum
+{
+  CHANNELS_LEFT_SIDE  = 8,
+  CHANNELS_SIDE_RIGHT = 9,
+  CHANNELS_MID_SIDE   = 10
+};
+
+/* State of the partitioned Rice coded residual */
+struct Residual
+{
+  /* Samples in each partition */
+  size_t length;
+  /* Samples left in the current partition */
+  size_t left;
+  /* Rice parameter of the current partition */
+  uint32_t parameter;
+  /* Parameter value for unencoded partitions */
+  uint32_t escape;
+  /* Sample width of unencoded partitions */
+  unsigned int raw;
+  /* Width of Rice parameters */
+  unsigned int width;
+};
+/*----------------------------------------------------------------------------*/
+static enum FlacStatus decodeFrame(struct FlacDecoder *);
+static bool decodeSubframe(struct FlacDecoder *, unsigned int, unsigned int);
+static bool parseFrameHeader(struct FlacDecoder *, const uint8_t *, size_t *);
+static enum FlacStatus readFrameHeader(struct FlacDecoder *, size_t *);
+static bool readResidualHeader(struct FlacDecoder *, struct Residual *,
+    size_t, unsigned int);
+static void readResidual(struct FlacDecoder *, struct Residual *, int32_t *,
+    size_t);
+static void restoreFixed(int32_t *, size_t, unsigned int);
+static void restoreLinear(int32_t *, size_t, const int32_t *, unsigned int,
+    unsigned int);
+static void restoreLinearWide(int32_t *, size_t, const int32_t *,
+    unsigned int, unsigned int);
+static void storeSamples(struct FlacDecoder *, unsigned int, const int32_t *,
+    size_t, size_t, unsigned int);
+
+static inline void alignToByte(struct FlacDecoder *);
+static inline uint8_t computeHeaderCrc(const uint8_t *, size_t);
+static inline unsigned int getBitCount(uint32_t);
+static inline unsigned int getNumberLength(uint8_t);
+static inline uint32_t readBits(struct FlacDecoder *, unsigned int);
+static inline int32_t readSigned(struct FlacDecoder *, unsigned int);
+static inline uint32_t readUnary(struct FlacDecoder *);
+static inline void refill(struct FlacDecoder *);
+static inline void writeFrame(uint32_t *, int32_t, int32_t, unsigned int);
+/*----------------------------------------------------------------------------*/
+static const uint8_t sampleDepthTable[] = {
+    0, 8, 12, 0, 16, 20, 24, 0
+};
+/*----------------------------------------------------------------------------*/
+static enum FlacStatus decodeFrame(struct FlacDecoder *decoder)
+{
+  while (1)
+  {
+    size_t length;
+    const enum FlacStatus status = readFrameHeader(decoder, &length);
+
+    if (status != FLAC_OK)
+      return status;
+
+    bool ok = true;
+
+    decoder->length = length;
+    decoder->position = 0;
+
+    for (unsigned int channel = 0; ok && channel < decoder->channels;
+        ++channel)
+    {
+      const bool side =
+          (decoder->assignment == CHANNELS_LEFT_SIDE && channel == 1)
+          || (decoder->assignment == CHANNELS_SIDE_RIGHT && channel == 0)
+          || (decoder->assignment == CHANNELS_MID_SIDE && channel == 1);
+
+      /* Side channel has one extra bit */
+      ok = decodeSubframe(decoder, channel, decoder->frameDepth + side);
+    }
+
+    /* Zero padding and frame CRC, the CRC is not checked */
+    alignToByte(decoder);
+    readBits(decoder, 16);
+
+    if (decoder->error)
+      return FLAC_ERROR;
+
+    if (decoder->underflow)
+    {
+      /* Truncated frame at the end of the stream */
+      decoder->length = 0;
+      return FLAC_END;
+    }
+
+    if (ok)
+    {
+      if (decoder->target > decoder->sample)
+      {
+        /* Skip samples before the seek target */
+        const uint64_t skip = decoder->target - decoder->sample;
+        decoder->position = skip < length ? (size_t)skip : length;
+      }
+
+      return FLAC_OK;
+    }
+
+    /* Corrupted frame is dropped, search for the next one */
+    decoder->length = 0;
+    decoder->synced = false;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bool decodeSubframe(struct FlacDecoder *decoder, unsigned int channel,
+    unsigned int depth)
+{
+  /* Samples of the current segment are placed after the predictor history */
+  int32_t * const samples = decoder->window + FLAC_MAX_ORDER;
+  const size_t length = decoder->length;
+  const uint32_t header = readBits(decoder, 8);
+  const unsigned int type = (header >> 1) & 0x3F;
+  unsigned int wasted = 0;
+
+  /* Zero padding bit */
+  if (header & 0x80)
+    return false;
+
+  if (header & 0x01)
+  {
+    /* Wasted bits per sample in the unary code */
+    wasted = readUnary(decoder) + 1;
+    if (wasted >= depth)
+      return false;
+
+    depth -= wasted;
+  }
+
+  if (type <= 1)
+  {
+    /* Constant value or verbatim samples */
+    const int32_t value = type == 0 ? readSigned(decoder, depth) : 0;
+
+    for (size_t index = 0; index < length; index += FLAC_SEGMENT_LENGTH)
+    {
+      const size_t count = MIN(length - index, FLAC_SEGMENT_LENGTH);
+
+      for (size_t i = 0; i < count; ++i)
+        samples[i] = type == 0 ? value : readSigned(decoder, depth);
+
+      storeSamples(decoder, channel, samples, index, count, wasted);
+    }
+
+    return !decoder->underflow;
+  }
+
+  int32_t coefficients[FLAC_MAX_ORDER];
+  unsigned int order;
+  unsigned int precision = 0;
+  unsigned int shift = 0;
+  bool wide = false;
+
+  if (type >= 8 && type <= 12)
+  {
+    /* Fixed polynomial predictor */
+    order = type - 8;
+  }
+  else if (type >= 32)
+  {
+    /* Linear predictor */
+    order = type - 31;
+  }
+  else
+    return false;
+
+  if (order > length)
+    return false;
+
+  /* Warm-up samples are placed at the end of the history */
+  for (unsigned int i = 0; i < order; ++i)
+    samples[(int)i - (int)order] = readSigned(decoder, depth);
+
+  storeSamples(decoder, channel, samples - order, 0, order, wasted);
+
+  if (type >= 32)
+  {
+    precision = readBits(decoder, 4) + 1;
+    if (precision == 16)
+      return false;
+
+    const int32_t value = readSigned(decoder, 5);
+
+    /* Negative shifts are not allowed */
+    if (value < 0)
+      return false;
+    shift = (unsigned int)value;
+
+    for (unsigned int i = 0; i < order; ++i)
+      coefficients[i] = readSigned(decoder, precision);
+
+    /* Use 64-bit accumulator when the sum may overflow */
+    wide = depth + precision + getBitCount(order) > 32;
+  }
+
+  struct Residual residual;
+
+  if (!readResidualHeader(decoder, &residual, length, order))
+    return false;
+
+  for (size_t index = order; index < length;)
+  {
+    const size_t count = MIN(length - index, FLAC_SEGMENT_LENGTH);
+
+    readResidual(decoder, &residual, samples, count);
+    if (decoder->underflow)
+      return false;
+
+    if (type < 32)
+      restoreFixed(samples, count, order);
+    else if (!wide)
+      restoreLinear(samples, count, coefficients, order, shift);
+    else
+      restoreLinearWide(samples, count, coefficients, order, shift);
+
+    storeSamples(decoder, channel, samples, index, count, wasted);
+
+    /* Keep the history for the next segment */
+    memmove(samples - order, samples + count - order,
+        order * sizeof(int32_t));
+    index += count;
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool parseFrameHeader(struct FlacDecoder *decoder,
+    const uint8_t *header, size_t *length)
+{
+  const unsigned int blockCode = header[2] >> 4;
+  const unsigned int rateCode = header[2] & 0x0F;
+  const unsigned int assignment = header[3] >> 4;
+  const unsigned int depthCode = (header[3] >> 1) & 0x07;
+  size_t position = 4;
+  uint64_t number;
+
+  /* Reserved bit and reserved values */
+  if ((header[3] & 0x01) || !blockCode || rateCode == 15 || assignment > 10)
+    return false;
+
+  /* Frame or sample number in the extended UTF-8 coding */
+  const unsigned int count = getNumberLength(header[position]);
+
+  if (count > 1)
+  {
+    number = header[position++] & (0x7F >> count);
+
+    for (unsigned int i = 1; i < count; ++i)
+    {
+      if ((header[position] & 0xC0) != 0x80)
+        return false;
+
+      number = (number << 6) | (header[position++] & 0x3F);
+    }
+  }
+  else
+    number = header[position++];
+
+  if (blockCode == 1)
+    *length = 192;
+  else if (blockCode <= 5)
+    *length = 576 << (blockCode - 2);
+  else if (blockCode == 6)
+    *length = (size_t)header[position++] + 1;
+  else if (blockCode == 7)
+  {
+    *length = (((size_t)header[position] << 8) | header[position + 1]) + 1;
+    position += 2;
+  }
+  else
+    *length = 256 << (blockCode - 8);
+
+  if (rateCode == 12)
+    ++position;
+  else if (rateCode == 13 || rateCode == 14)
+    position += 2;
+
+  if (computeHeaderCrc(header, position) != header[position])
+    return false;
+
+  const unsigned int depth = depthCode ?
+      sampleDepthTable[depthCode] : decoder->depth;
+  const unsigned int channels = assignment < 8 ? assignment + 1 : 2;
+
+  if (!depth || channels > 2 || *length > FLAC_BLOCK_LENGTH)
+    return false;
+
+  /* Fixed block size streams use frame numbers */
+  if (!decoder->synced)
+  {
+    decoder->sample = (header[1] & 0x01) ? number : number * (*length);
+    decoder->synced = true;
+  }
+
+  decoder->assignment = (uint8_t)assignment;
+  decoder->channels = (uint8_t)channels;
+  decoder->frameDepth = (uint8_t)depth;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static enum FlacStatus readFrameHeader(struct FlacDecoder *decoder,
+    size_t *length)
+{
+  uint8_t header[MAX_HEADER_LENGTH];
+  uint32_t previous = 0;
+
+  while (1)
+  {
+    /* Sync code is followed by a reserved bit and a blocking strategy bit */
+    const uint32_t current = readBits(decoder, 8);
+
+    if (decoder->underflow)
+      return decoder->error ? FLAC_ERROR : FLAC_END;
+
+    if (previous != 0xFF || (current & 0xFE) != 0xF8)
+    {
+      previous = current;
+      continue;
+    }
+    previous = 0;
+
+    header[0] = 0xFF;
+    header[1] = (uint8_t)current;
+    header[2] = (uint8_t)readBits(decoder, 8);
+    header[3] = (uint8_t)readBits(decoder, 8);
+    header[4] = (uint8_t)readBits(decoder, 8);
+
+    /* Length of the coded number is derived from the first byte */
+    const unsigned int extra = getNumberLength(header[4]);
+
+    if (!extra)
+      continue;
+
+    size_t count = 4 + extra;
+
+    const unsigned int blockCode = header[2] >> 4;
+    const unsigned int rateCode = header[2] & 0x0F;
+
+    if (blockCode == 6)
+      count += 1;
+    else if (blockCode == 7)
+      count += 2;
+
+    if (rateCode == 12)
+      count += 1;
+    else if (rateCode == 13 || rateCode == 14)
+      count += 2;
+
+    /* Header CRC */
+    ++count;
+
+    for (size_t i = 5; i < count; ++i)
+      header[i] = (uint8_t)readBits(decoder, 8);
+
+    if (decoder->underflow)
+      return decoder->error ? FLAC_ERROR : FLAC_END;
+
+    if (parseFrameHeader(decoder, header, length))
+      return FLAC_OK;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bool readResidualHeader(struct FlacDecoder *decoder,
+    struct Residual *residual, size_t length, unsigned int order)
+{
+  const uint32_t method = readBits(decoder, 2);
+
+  if (method > 1)
+    return false;
+
+  const unsigned int partitions = readBits(decoder, 4);
+
+  residual->length = length >> partitions;
+  if ((residual->length << partitions) != length || residual->length < order)
+    return false;
+
+  /* Parameters of the second coding method are 5 bits wide */
+  residual->width = method ? 5 : 4;
+  residual->escape = method ? 31 : 15;
+
+  /* Warm-up samples are included in the first partition */
+  residual->left = residual->length - order;
+  residual->parameter = readBits(decoder, residual->width);
+  residual->raw = residual->parameter == residual->escape ?
+      readBits(decoder, 5) : 0;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void readResidual(struct FlacDecoder *decoder,
+    struct Residual *residual, int32_t *samples, size_t count)
+{
+  while (count)
+  {
+    if (!residual->left)
+    {
+      residual->left = residual->length;
+      residual->parameter = readBits(decoder, residual->width);
+      residual->raw = residual->parameter == residual->escape ?
+          readBits(decoder, 5) : 0;
+    }
+
+    const size_t chunk = MIN(residual->left, count);
+    const unsigned int parameter = residual->parameter;
+
+    if (parameter == residual->escape)
+    {
+      /* Unencoded partition */
+      for (size_t i = 0; i < chunk; ++i)
+        samples[i] = readSigned(decoder, residual->raw);
+    }
+    else
+    {
+      for (size_t i = 0; i < chunk; ++i)
+      {
+        const uint32_t value = (readUnary(decoder) << parameter)
+            | readBits(decoder, parameter);
+
+        /* Zigzag coding of signed values */
+        samples[i] = (int32_t)(value >> 1) ^ -(int32_t)(value & 1);
+      }
+    }
+
+    residual->left -= chunk;
+    samples += chunk;
+    count -= chunk;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void restoreFixed(int32_t *samples, size_t count, unsigned int order)
+{
+  switch (order)
+  {
+    case 1:
+      for (size_t i = 0; i < count; ++i)
+        samples[i] += samples[i - 1];
+      break;
+
+    case 2:
+      for (size_t i = 0; i < count; ++i)
+        samples[i] += 2 * samples[i - 1] - samples[i - 2];
+      break;
+
+    case 3:
+      for (size_t i = 0; i < count; ++i)
+      {
+        samples[i] += 3 * (samples[i - 1] - samples[i - 2])
+            + samples[i - 3];
+      }
+      break;
+
+    case 4:
+      for (size_t i = 0; i < count; ++i)
+      {
+        samples[i] += 4 * (samples[i - 1] + samples[i - 3])
+            - 6 * samples[i - 2] - samples[i - 4];
+      }
+      break;
+
+    default:
+      break;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void restoreLinear(int32_t *samples, size_t count,
+    const int32_t *coefficients, unsigned int order, unsigned int shift)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    const int32_t *history = samples + i;
+    int32_t sum = 0;
+
+    for (unsigned int j = 0; j < order; ++j)
+      sum += coefficients[j] * *--history;
+
+    samples[i] += sum >> shift;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void restoreLinearWide(int32_t *samples, size_t count,
+    const int32_t *coefficients, unsigned int order, unsigned int shift)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    const int32_t *history = samples + i;
+    int64_t sum = 0;
+
+    for (unsigned int j = 0; j < order; ++j)
+      sum += (int64_t)coefficients[j] * *--history;
+
+    samples[i] += (int32_t)(sum >> shift);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void storeSamples(struct FlacDecoder *decoder, unsigned int channel,
+    const int32_t *samples, size_t index, size_t count, unsigned int wasted)
+{
+  static const size_t stride = PCM_FRAME_SIZE / sizeof(uint32_t);
+
+  uint32_t *frame = decoder->frames + index * stride;
+  const unsigned int shift = 32 - decoder->frameDepth;
+
+  if (decoder->channels == 1)
+  {
+    for (size_t i = 0; i < count; ++i, frame += stride)
+    {
+      const int32_t value = (int32_t)((uint32_t)samples[i] << wasted);
+      writeFrame(frame, value, value, shift);
+    }
+  }
+  else if (channel == 0)
+  {
+    /* First channel is kept in the frame until the second one is decoded */
+    for (size_t i = 0; i < count; ++i, frame += stride)
+      *frame = (uint32_t)samples[i] << wasted;
+  }
+  else
+  {
+    for (size_t i = 0; i < count; ++i, frame += stride)
+    {
+      const int32_t a = (int32_t)*frame;
+      const int32_t b = (int32_t)((uint32_t)samples[i] << wasted);
+      int32_t left;
+      int32_t right;
+
+      switch (decoder->assignment)
+      {
+        case CHANNELS_LEFT_SIDE:
+          left = a;
+          right = a - b;
+          break;
+
+        case CHANNELS_SIDE_RIGHT:
+          left = a + b;
+          right = b;
+          break;
+
+        case CHANNELS_MID_SIDE:
+        {
+          const int32_t mid = (int32_t)(((uint32_t)a << 1) | (b & 1));
+
+          left = (mid + b) >> 1;
+          right = (mid - b) >> 1;
+          break;
+        }
+
+        default:
+          left = a;
+          right = b;
+          break;
+      }
+
+      writeFrame(frame, left, right, shift);
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline void alignToByte(struct FlacDecoder *decoder)
+{
+  readBits(decoder, decoder->bits & 7);
+}
+/*----------------------------------------------------------------------------*/
+static inline uint8_t computeHeaderCrc(const uint8_t *data, size_t length)
+{
+  uint8_t crc = 0;
+
+  /* CRC-8 with polynomial x^8 + x^2 + x + 1 */
+  while (length--)
+  {
+    crc ^= *data++;
+
+    for (unsigned int i = 0; i < 8; ++i)
+      crc = (crc & 0x80) ? (uint8_t)((crc << 1) ^ 0x07) : (uint8_t)(crc << 1);
+  }
+
+  return crc;
+}
+/*----------------------------------------------------------------------------*/
+static inline unsigned int getBitCount(uint32_t value)
+{
+  return value ? 32 - (unsigned int)__builtin_clz(value) : 0;
+}
+/*----------------------------------------------------------------------------*/
+static inline unsigned int getNumberLength(uint8_t value)
+{
+  unsigned int ones = 0;
+
+  while (ones < 8 && (value & (0x80 >> ones)))
+    ++ones;
+
+  /* Returns zero for continuation bytes and invalid values */
+  if (!ones)
+    return 1;
+  else
+    return ones >= 2 && ones <= 7 ? ones : 0;
+}
+/*----------------------------------------------------------------------------*/
+static inline uint32_t readBits(struct FlacDecoder *decoder, unsigned int count)
+{
+  if (!count)
+    return 0;
+
+  if (decoder->bits < count)
+  {
+    refill(decoder);
+
+    if (decoder->bits < count)
+    {
+      /* Missing bits are read as zeros */
+      decoder->underflow = true;
+      decoder->bits = count;
+    }
+  }
+
+  const uint32_t value = (uint32_t)(decoder->cache >> (64 - count));
+
+  decoder->cache <<= count;
+  decoder->bits -= count;
+  return value;
+}
+/*----------------------------------------------------------------------------*/
+static inline int32_t readSigned(struct FlacDecoder *decoder,
+    unsigned int count)
+{
+  if (!count)
+    return 0;
+
+  const uint32_t value = readBits(decoder, count) << (32 - count);
+  return (int32_t)value >> (32 - count);
+}
+/*----------------------------------------------------------------------------*/
+static inline uint32_t readUnary(struct FlacDecoder *decoder)
+{
+  uint32_t value = 0;
+
+  while (1)
+  {
+    if (decoder->cache)
+    {
+      /* Bits after the valid part of the cache are always zero */
+      const unsigned int zeros = (unsigned int)__builtin_clzll(decoder->cache);
+
+      decoder->cache <<= zeros;
+      decoder->cache <<= 1;
+      decoder->bits -= zeros + 1;
+      return value + zeros;
+    }
+
+    value += decoder->bits;
+    decoder->bits = 0;
+    refill(decoder);
+
+    if (!decoder->bits)
+    {
+      decoder->underflow = true;
+      return value;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline void refill(struct FlacDecoder *decoder)
+{
+  while (decoder->bits <= 56)
+  {
+    if (!decoder->size)
+    {
+      if (decoder->exhausted)
+        break;
+
+      if (!decoder->fill(decoder->argument, &decoder->data, &decoder->size))
+        decoder->error = true;
+      if (decoder->error || !decoder->size)
+      {
+        decoder->exhausted = true;
+        break;
+      }
+    }
+
+    decoder->cache |= (uint64_t)*decoder->data++ << (56 - decoder->bits);
+    decoder->bits += 8;
+    --decoder->size;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static inline void writeFrame(uint32_t *frame, int32_t left, int32_t right,
+    unsigned int shift)
+{
+  /* Samples are aligned to the most significant bit */
+  const uint32_t a = (uint32_t)left << shift;
+  const uint32_t b = (uint32_t)right << shift;
+
+#if PCM_OUTPUT_WIDTH == 16
+  frame[0] = (b & 0xFFFF0000UL) | (a >> 16);
+#else
+  frame[0] = a;
+  frame[1] = b;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+void flacDecoderInit(struct FlacDecoder *decoder,
+    bool (*fill)(void *, const uint8_t **, size_t *), void *argument)
+{
+  decoder->fill = fill;
+  decoder->argument = argument;
+
+  flacDecoderReset(decoder, 0, 0, 0);
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the number of the first sample after the decoded block */
+uint64_t flacDecoderGetDecoded(const struct FlacDecoder *decoder)
+{
+  return decoder->sample + decoder->length;
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the number of the next sample to be read */
+uint64_t flacDecoderGetSample(const struct FlacDecoder *decoder)
+{
+  return decoder->sample + decoder->position;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Reads decoded frames in the output format, frames of the next block are
+ * decoded when the current block is exhausted.
+ */
+enum FlacStatus flacDecoderRead(struct FlacDecoder *decoder, void *buffer,
+    size_t capacity, size_t *count)
+{
+  static const size_t stride = PCM_FRAME_SIZE / sizeof(uint32_t);
+
+  const size_t frames = capacity / PCM_FRAME_SIZE;
+  enum FlacStatus status = FLAC_OK;
+  size_t processed = 0;
+
+  while (processed < frames)
+  {
+    if (decoder->position >= decoder->length)
+    {
+      decoder->sample += decoder->length;
+      decoder->length = 0;
+      decoder->position = 0;
+
+      status = decodeFrame(decoder);
+      if (status != FLAC_OK)
+        break;
+
+      continue;
+    }
+
+    const size_t chunk = MIN(frames - processed,
+        decoder->length - decoder->position);
+
+    memcpy((uint8_t *)buffer + processed * PCM_FRAME_SIZE,
+        decoder->frames + decoder->position * stride,
+        chunk * PCM_FRAME_SIZE);
+
+    decoder->position += chunk;
+    processed += chunk;
+  }
+
+  *count = processed * PCM_FRAME_SIZE;
+  return status;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Drops buffered data and sets default stream parameters. Decoding starts
+ * from the next frame found in the input, samples before the target sample
+ * are skipped.
+ */
+void flacDecoderReset(struct FlacDecoder *decoder, uint32_t rate,
+    uint8_t depth, uint64_t target)
+{
+  decoder->data = NULL;
+  decoder->size = 0;
+  decoder->cache = 0;
+  decoder->bits = 0;
+
+  decoder->exhausted = false;
+  decoder->error = false;
+  decoder->underflow = false;
+  decoder->synced = false;
+
+  decoder->rate = rate;
+  decoder->depth = depth;
+
+  decoder->sample = 0;
+  decoder->target = target;
+  decoder->length = 0;
+  decoder->position = 0;
+}
+/*----------------------------------------------------------------------------*/
+bool flacParseStreamInfo(const uint8_t *data, struct FlacStreamInfo *info)
+{
+  uint16_t blockSize;
+  uint32_t samples;
+
+  memcpy(&blockSize, data, sizeof(blockSize));
+  info->minBlockSize = fromBigEndian16(blockSize);
+  memcpy(&blockSize, data + 2, sizeof(blockSize));
+  info->maxBlockSize = fromBigEndian16(blockSize);
+
+  /* Sample rate, channels and depth are packed into 28 bits */
+  info->rate = ((uint32_t)data[10] << 12) | ((uint32_t)data[11] << 4)
+      | (data[12] >> 4);
+  info->channels = ((data[12] >> 1) & 0x07) + 1;
+  info->depth = (((data[12] & 0x01) << 4) | (data[13] >> 4)) + 1;
+
+  memcpy(&samples, data + 14, sizeof(samples));
+  info->samples = ((uint64_t)(data[13] & 0x0F) << 32)
+      | fromBigEndian32(samples);
+
+  return info->rate > 0 && info->minBlockSize >= 16
+      && info->maxBlockSize >= info->minBlockSize;
+}
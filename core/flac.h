@@ -0,0 +1,108 @@
+/*
+ * core/flac.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_FLAC_H_
+#define CORE_FLAC_H_
+/*----------------------------------------------------------------------------*/
+#include "pcm_convert.h"
+#include <stdbool.h>
+/*----------------------------------------------------------------------------*/
+#ifndef CONFIG_FLAC_BLOCK_LENGTH
+#  define FLAC_BLOCK_LENGTH 4608
+#else
+#  define FLAC_BLOCK_LENGTH CONFIG_FLAC_BLOCK_LENGTH
+#endif
+
+/* Length of the STREAMINFO metadata block without the block header */
+#define FLAC_STREAMINFO_LENGTH  34
+/* Maximum order of linear predictors */
+#define FLAC_MAX_ORDER          32
+/* Samples restored in one pass of the predictor */
+#define FLAC_SEGMENT_LENGTH     128
+
+enum [[gnu::packed]] FlacStatus
+{
+  FLAC_OK,
+  FLAC_END,
+  FLAC_ERROR
+};
+
+struct FlacStreamInfo
+{
+  /* Total number of samples per channel, zero when unknown */
+  uint64_t samples;
+  /* Sample rate */
+  uint32_t rate;
+  /* Minimum and maximum block sizes in samples */
+  uint16_t minBlockSize;
+  uint16_t maxBlockSize;
+  /* Channel count */
+  uint8_t channels;
+  /* Bits per sample */
+  uint8_t depth;
+};
+
+struct FlacDecoder
+{
+  /* Input callback, it returns an empty chunk at the end of the stream */
+  bool (*fill)(void *, const uint8_t **, size_t *);
+  void *argument;
+
+  /* Unread input data */
+  const uint8_t *data;
+  size_t size;
+  /* Input bits aligned to the most significant bit */
+  uint64_t cache;
+  /* Number of valid bits in the cache */
+  unsigned int bits;
+
+  /* Input callback returned no data */
+  bool exhausted;
+  /* Input callback failed */
+  bool error;
+  /* Bit reader ran out of data */
+  bool underflow;
+  /* Sample number of the next frame is known */
+  bool synced;
+
+  /* Default stream parameters */
+  uint32_t rate;
+  uint8_t depth;
+
+  /* Parameters of the current frame */
+  uint8_t assignment;
+  uint8_t channels;
+  uint8_t frameDepth;
+
+  /* Number of the first sample of the decoded block */
+  uint64_t sample;
+  /* Samples before this position are skipped */
+  uint64_t target;
+  /* Frames in the decoded block */
+  size_t length;
+  /* Frames of the decoded block that are already read */
+  size_t position;
+
+  /* Predictor history followed by samples of the current segment */
+  int32_t window[FLAC_MAX_ORDER + FLAC_SEGMENT_LENGTH];
+  /* Decoded block in the output format */
+  uint32_t frames[FLAC_BLOCK_LENGTH * PCM_FRAME_SIZE / sizeof(uint32_t)];
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+void flacDecoderInit(struct FlacDecoder *,
+    bool (*)(void *, const uint8_t **, size_t *), void *);
+uint64_t flacDecoderGetDecoded(const struct FlacDecoder *);
+uint64_t flacDecoderGetSample(const struct FlacDecoder *);
+enum FlacStatus flacDecoderRead(struct FlacDecoder *, void *, size_t,
+    size_t *);
+void flacDecoderReset(struct FlacDecoder *, uint32_t, uint8_t, uint64_t);
+bool flacParseStreamInfo(const uint8_t *, struct FlacStreamInfo *);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_FLAC_H_ */
@@ -5,9 +5,33 @@
  */
 
 #include "interface_proxy.h"
+#include <halm/timer.h>
+#include <xcore/asm.h>
+#include <xcore/helpers.h>
 #include <assert.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+#define LINE_EMPTY  UINT32_MAX
+#define NO_LINE     SIZE_MAX
+/*----------------------------------------------------------------------------*/
+static size_t findLine(const struct InterfaceProxy *, uint32_t);
+static void invalidateLines(struct InterfaceProxy *);
+static bool isBuffered(const struct InterfaceProxy *, uint64_t);
+static void onTransferCompleted(void *);
+static bool pipeRead(struct InterfaceProxy *, uint64_t, void *, size_t);
+static bool pipeWrite(struct InterfaceProxy *, uint64_t, const void *,
+    size_t);
+static size_t readCached(struct InterfaceProxy *, void *);
+static size_t readStream(struct InterfaceProxy *, void *, size_t);
+static size_t selectLine(const struct InterfaceProxy *, uint32_t);
+static void startReadAhead(struct InterfaceProxy *, uint64_t);
+static void updateLines(struct InterfaceProxy *, uint64_t, const void *,
+    size_t, bool);
+static void waitReadAhead(struct InterfaceProxy *);
+static bool waitTransfer(struct InterfaceProxy *);
 /*----------------------------------------------------------------------------*/
 static enum Result interfaceInit(void *, const void *);
+static void interfaceDeinit(void *);
 static void interfaceSetCallback(void *, void (*)(void *), void *);
 static enum Result interfaceGetParam(void *, int, void *);
 static enum Result interfaceSetParam(void *, int, const void *);
@@ -18,7 +42,7 @@ const struct InterfaceClass * const InterfaceProxy =
     &(const struct InterfaceClass){
     .size = sizeof(struct InterfaceProxy),
     .init = interfaceInit,
-    .deinit = NULL, /* Use default destructor */
+    .deinit = interfaceDeinit,
 
     .setCallback = interfaceSetCallback,
     .getParam = interfaceGetParam,
@@ -27,22 +51,409 @@ const struct InterfaceClass * const InterfaceProxy =
     .write = interfaceWrite
 };
 /*----------------------------------------------------------------------------*/
+static size_t findLine(const struct InterfaceProxy *interface, uint32_t sector)
+{
+  const size_t first = (sector % interface->cache.sets)
+      * INTERFACE_PROXY_CACHE_WAYS;
+
+  for (size_t index = first; index < first + INTERFACE_PROXY_CACHE_WAYS;
+      ++index)
+  {
+    if (interface->cache.tags[index].sector == sector)
+      return index;
+  }
+
+  return NO_LINE;
+}
+/*----------------------------------------------------------------------------*/
+static void invalidateLines(struct InterfaceProxy *interface)
+{
+  const size_t count = interface->cache.sets * INTERFACE_PROXY_CACHE_WAYS;
+
+  for (size_t index = 0; index < count; ++index)
+    interface->cache.tags[index].sector = LINE_EMPTY;
+}
+/*----------------------------------------------------------------------------*/
+static bool isBuffered(const struct InterfaceProxy *interface,
+    uint64_t position)
+{
+  return interface->ahead.valid && position >= interface->ahead.position
+      && position - interface->ahead.position < interface->ahead.count;
+}
+/*----------------------------------------------------------------------------*/
+static void onTransferCompleted(void *argument)
+{
+  struct InterfaceProxy * const interface = argument;
+  interface->ahead.busy = false;
+}
+/*----------------------------------------------------------------------------*/
+static bool pipeRead(struct InterfaceProxy *interface, uint64_t position,
+    void *buffer, size_t length)
+{
+  const uint64_t address = position + interface->offset;
+
+  if (interface->ahead.failed)
+    return false;
+  if (ifSetParam(interface->pipe, IF_POSITION_64, &address) != E_OK)
+    return false;
+
+  if (interface->ahead.buffer == NULL)
+    return ifRead(interface->pipe, buffer, length) == length;
+
+  interface->ahead.busy = true;
+  if (ifRead(interface->pipe, buffer, length) != length)
+  {
+    interface->ahead.busy = false;
+    return false;
+  }
+
+  if (!waitTransfer(interface))
+    return false;
+  return ifGetParam(interface->pipe, IF_STATUS, NULL) == E_OK;
+}
+/*----------------------------------------------------------------------------*/
+static bool pipeWrite(struct InterfaceProxy *interface, uint64_t position,
+    const void *buffer, size_t length)
+{
+  const uint64_t address = position + interface->offset;
+
+  if (interface->ahead.failed)
+    return false;
+  if (ifSetParam(interface->pipe, IF_POSITION_64, &address) != E_OK)
+    return false;
+
+  if (interface->ahead.buffer == NULL)
+    return ifWrite(interface->pipe, buffer, length) == length;
+
+  interface->ahead.busy = true;
+  if (ifWrite(interface->pipe, buffer, length) != length)
+  {
+    interface->ahead.busy = false;
+    return false;
+  }
+
+  if (!waitTransfer(interface))
+    return false;
+  return ifGetParam(interface->pipe, IF_STATUS, NULL) == E_OK;
+}
+/*----------------------------------------------------------------------------*/
+static size_t readCached(struct InterfaceProxy *interface, void *buffer)
+{
+  const uint32_t sector =
+      (uint32_t)(interface->position / INTERFACE_PROXY_SECTOR_SIZE);
+  size_t index = findLine(interface, sector);
+  uint8_t *line;
+
+  if (index != NO_LINE)
+  {
+    /* Hit does not touch the underlying interface and the read-ahead state */
+    line = interface->cache.lines + index * INTERFACE_PROXY_SECTOR_SIZE;
+    interface->position += INTERFACE_PROXY_SECTOR_SIZE;
+    ++interface->cache.hits;
+  }
+  else
+  {
+    index = selectLine(interface, sector);
+    line = interface->cache.lines + index * INTERFACE_PROXY_SECTOR_SIZE;
+    interface->cache.tags[index].sector = LINE_EMPTY;
+    ++interface->cache.misses;
+
+    if (readStream(interface, line, INTERFACE_PROXY_SECTOR_SIZE)
+        != INTERFACE_PROXY_SECTOR_SIZE)
+    {
+      return 0;
+    }
+
+    interface->cache.tags[index].sector = sector;
+  }
+
+  interface->cache.tags[index].stamp = ++interface->cache.clock;
+  memcpy(buffer, line, INTERFACE_PROXY_SECTOR_SIZE);
+  return INTERFACE_PROXY_SECTOR_SIZE;
+}
+/*----------------------------------------------------------------------------*/
+static size_t readStream(struct InterfaceProxy *interface, void *buffer,
+    size_t length)
+{
+  if (interface->ahead.buffer == NULL)
+  {
+    if (!pipeRead(interface, interface->position, buffer, length))
+      return 0;
+
+    interface->position += length;
+    return length;
+  }
+
+  waitReadAhead(interface);
+
+  const bool sequential = interface->position == interface->ahead.last;
+  uint64_t position = interface->position;
+  uint8_t *output = buffer;
+  size_t left = length;
+  bool hit = false;
+
+  while (left)
+  {
+    size_t chunk;
+
+    if (isBuffered(interface, position))
+    {
+      const size_t offset = (size_t)(position - interface->ahead.position);
+
+      chunk = MIN(left, interface->ahead.count - offset);
+      memcpy(output, interface->ahead.buffer + offset, chunk);
+      hit = true;
+    }
+    else
+    {
+      chunk = left;
+
+      /* Stop before the buffered block to take the rest from the buffer */
+      if (interface->ahead.valid && interface->ahead.position > position
+          && interface->ahead.position - position < (uint64_t)chunk)
+      {
+        chunk = (size_t)(interface->ahead.position - position);
+      }
+
+      if (!pipeRead(interface, position, output, chunk))
+        break;
+    }
+
+    output += chunk;
+    position += chunk;
+    left -= chunk;
+  }
+
+  interface->position = position;
+  interface->ahead.last = position;
+
+  /*
+   * The stream continues after sequential reads, the next block is loaded
+   * while the caller processes the data just read.
+   */
+  if (!left && (sequential || hit) && !isBuffered(interface, position))
+    startReadAhead(interface, position);
+
+  return length - left;
+}
+/*----------------------------------------------------------------------------*/
+static size_t selectLine(const struct InterfaceProxy *interface,
+    uint32_t sector)
+{
+  const size_t first = (sector % interface->cache.sets)
+      * INTERFACE_PROXY_CACHE_WAYS;
+  size_t victim = first;
+
+  /* Empty line or the least recently used one */
+  for (size_t index = first; index < first + INTERFACE_PROXY_CACHE_WAYS;
+      ++index)
+  {
+    if (interface->cache.tags[index].sector == LINE_EMPTY)
+      return index;
+
+    if (interface->cache.clock - interface->cache.tags[index].stamp
+        > interface->cache.clock - interface->cache.tags[victim].stamp)
+    {
+      victim = index;
+    }
+  }
+
+  return victim;
+}
+/*----------------------------------------------------------------------------*/
+static void startReadAhead(struct InterfaceProxy *interface, uint64_t position)
+{
+  const uint64_t address = position + interface->offset;
+  size_t count = interface->ahead.length;
+
+  if (interface->size != 0)
+  {
+    if (address >= interface->size)
+      return;
+    count = (size_t)MIN((uint64_t)count, interface->size - address);
+  }
+
+  interface->ahead.position = position;
+  interface->ahead.count = count;
+  interface->ahead.valid = false;
+
+  if (interface->ahead.failed)
+    return;
+  if (ifSetParam(interface->pipe, IF_POSITION_64, &address) != E_OK)
+    return;
+
+  /* Transfer runs in the background until the next call to the proxy */
+  interface->ahead.busy = true;
+  if (ifRead(interface->pipe, interface->ahead.buffer, count) == count)
+    interface->ahead.valid = true;
+  else
+    interface->ahead.busy = false;
+}
+/*----------------------------------------------------------------------------*/
+static void updateLines(struct InterfaceProxy *interface, uint64_t position,
+    const void *buffer, size_t length, bool written)
+{
+  const uint64_t end = position + length;
+  uint64_t sector = position / INTERFACE_PROXY_SECTOR_SIZE;
+
+  for (; sector * INTERFACE_PROXY_SECTOR_SIZE < end; ++sector)
+  {
+    if (sector >= LINE_EMPTY)
+      break;
+
+    const size_t index = findLine(interface, (uint32_t)sector);
+
+    if (index == NO_LINE)
+      continue;
+
+    const uint64_t address = sector * INTERFACE_PROXY_SECTOR_SIZE;
+
+    /* Lines are refreshed when the sector was rewritten completely */
+    if (written && address >= position
+        && end - address >= INTERFACE_PROXY_SECTOR_SIZE)
+    {
+      memcpy(interface->cache.lines + index * INTERFACE_PROXY_SECTOR_SIZE,
+          (const uint8_t *)buffer + (size_t)(address - position),
+          INTERFACE_PROXY_SECTOR_SIZE);
+    }
+    else
+    {
+      interface->cache.tags[index].sector = LINE_EMPTY;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void waitReadAhead(struct InterfaceProxy *interface)
+{
+  if (interface->ahead.busy)
+  {
+    if (!waitTransfer(interface)
+        || ifGetParam(interface->pipe, IF_STATUS, NULL) != E_OK)
+    {
+      interface->ahead.valid = false;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bool waitTransfer(struct InterfaceProxy *interface)
+{
+  if (interface->ahead.failed)
+    return false;
+
+  const uint32_t start = interface->timer != NULL ?
+      timerGetValue(interface->timer) : 0;
+
+  while (interface->ahead.busy)
+  {
+    /*
+     * Completion callback is never called when the card stops responding
+     * in the middle of the transfer. The DMA may still write to the buffer
+     * later, therefore the underlying interface is abandoned after a timeout
+     * and all following requests fail until the proxy is reinitialized.
+     */
+    if (interface->timer != NULL
+        && timerGetValue(interface->timer) - start >= interface->timeout)
+    {
+      interface->ahead.failed = true;
+      return false;
+    }
+
+    barrier();
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
 static enum Result interfaceInit(void *object, const void *configBase)
 {
   const struct InterfaceProxyConfig * const config = configBase;
+  assert(config != NULL);
+  assert(config->pipe != NULL);
+  assert(config->buffer == NULL || config->length > 0);
+
   struct InterfaceProxy * const interface = object;
 
   interface->pipe = config->pipe;
   interface->offset = 0;
+  interface->position = 0;
+
+  if (ifGetParam(interface->pipe, IF_SIZE_64, &interface->size) != E_OK)
+    interface->size = 0;
+
+  interface->ahead.buffer = config->buffer;
+  interface->ahead.length = config->buffer != NULL ? config->length : 0;
+  interface->ahead.position = 0;
+  interface->ahead.last = 0;
+  interface->ahead.count = 0;
+  interface->ahead.busy = false;
+  interface->ahead.valid = false;
+  interface->ahead.failed = false;
+
+  interface->timer = config->timeout > 0 ? config->timer : NULL;
+  interface->timeout = interface->timer != NULL ?
+      (uint32_t)(((uint64_t)config->timeout
+          * timerGetFrequency(interface->timer) + 999) / 1000) : 0;
+
+  interface->cache.lines = NULL;
+  interface->cache.tags = NULL;
+  interface->cache.sets = 0;
+  interface->cache.clock = 0;
+  interface->cache.hits = 0;
+  interface->cache.misses = 0;
+
+  if (config->cache != NULL)
+  {
+    const size_t sets = config->cacheSize
+        / INTERFACE_PROXY_CACHE_SIZE(INTERFACE_PROXY_CACHE_WAYS);
+
+    if (sets > 0)
+    {
+      const size_t count = sets * INTERFACE_PROXY_CACHE_WAYS;
+
+      /* Tags are placed after the lines to keep lines aligned */
+      interface->cache.lines = config->cache;
+      interface->cache.tags = (struct InterfaceProxyTag *)
+          (interface->cache.lines + count * INTERFACE_PROXY_SECTOR_SIZE);
+      interface->cache.sets = sets;
+      invalidateLines(interface);
+    }
+  }
+
+  if (interface->ahead.buffer != NULL)
+  {
+    ifSetCallback(interface->pipe, onTransferCompleted, interface);
+
+    if (ifSetParam(interface->pipe, IF_ZEROCOPY, NULL) != E_OK)
+    {
+      ifSetCallback(interface->pipe, NULL, NULL);
+      return E_INTERFACE;
+    }
+  }
 
   return E_OK;
 }
 /*----------------------------------------------------------------------------*/
+static void interfaceDeinit(void *object)
+{
+  struct InterfaceProxy * const interface = object;
+
+  if (interface->ahead.buffer != NULL)
+  {
+    waitReadAhead(interface);
+
+    ifSetParam(interface->pipe, IF_BLOCKING, NULL);
+    ifSetCallback(interface->pipe, NULL, NULL);
+  }
+}
+/*----------------------------------------------------------------------------*/
 static void interfaceSetCallback(void *object, void (*callback)(void *),
     void *argument)
 {
   struct InterfaceProxy * const interface = object;
-  ifSetCallback(interface->pipe, callback, argument);
+
+  /* Proxy with the read-ahead buffer works in the blocking mode only */
+  if (interface->ahead.buffer == NULL)
+    ifSetCallback(interface->pipe, callback, argument);
 }
 /*----------------------------------------------------------------------------*/
 static enum Result interfaceGetParam(void *object, int parameter, void *data)
@@ -52,16 +463,8 @@ static enum Result interfaceGetParam(void *object, int parameter, void *data)
 
   if ((enum IfParameter)parameter == IF_POSITION_64)
   {
-    uint64_t position;
-
-    res = ifGetParam(interface->pipe, IF_POSITION_64, &position);
-    if (res == E_OK)
-    {
-      if (position >= interface->offset)
-        *(uint64_t *)data = position - interface->offset;
-      else
-        res = E_INTERFACE;
-    }
+    *(uint64_t *)data = interface->position;
+    res = E_OK;
   }
   else if ((enum IfParameter)parameter == IF_SIZE_64)
   {
@@ -76,6 +479,12 @@ static enum Result interfaceGetParam(void *object, int parameter, void *data)
         res = E_INTERFACE;
     }
   }
+  else if ((enum IfParameter)parameter == IF_STATUS
+      && interface->ahead.buffer != NULL)
+  {
+    /* Read-ahead transfers are hidden, other transfers are completed */
+    res = E_OK;
+  }
   else
   {
     res = ifGetParam(interface->pipe, parameter, data);
@@ -91,8 +500,18 @@ static enum Result interfaceSetParam(void *object, int parameter,
 
   if ((enum IfParameter)parameter == IF_POSITION_64)
   {
-    const uint64_t position = *(const uint64_t *)data + interface->offset;
-    return ifSetParam(interface->pipe, IF_POSITION_64, &position);
+    interface->position = *(const uint64_t *)data;
+    return E_OK;
+  }
+  else if (interface->ahead.buffer != NULL)
+  {
+    if ((enum IfParameter)parameter == IF_BLOCKING)
+      return E_OK;
+    if ((enum IfParameter)parameter == IF_ZEROCOPY)
+      return E_INVALID;
+
+    waitReadAhead(interface);
+    return ifSetParam(interface->pipe, parameter, data);
   }
   else
   {
@@ -103,17 +522,60 @@ static enum Result interfaceSetParam(void *object, int parameter,
 static size_t interfaceRead(void *object, void *buffer, size_t length)
 {
   struct InterfaceProxy * const interface = object;
-  return ifRead(interface->pipe, buffer, length);
+
+  /*
+   * Only single-sector reads of the file system metadata are cached,
+   * longer audio reads bypass the cache to avoid evicting metadata.
+   */
+  if (interface->cache.sets > 0 && length == INTERFACE_PROXY_SECTOR_SIZE
+      && interface->position % INTERFACE_PROXY_SECTOR_SIZE == 0
+      && interface->position / INTERFACE_PROXY_SECTOR_SIZE < LINE_EMPTY)
+  {
+    return readCached(interface, buffer);
+  }
+
+  return readStream(interface, buffer, length);
 }
 /*----------------------------------------------------------------------------*/
 static size_t interfaceWrite(void *object, const void *buffer, size_t length)
 {
   struct InterfaceProxy * const interface = object;
-  return ifWrite(interface->pipe, buffer, length);
+
+  waitReadAhead(interface);
+  interface->ahead.valid = false;
+
+  if (!pipeWrite(interface, interface->position, buffer, length))
+  {
+    if (interface->cache.sets > 0)
+      updateLines(interface, interface->position, buffer, length, false);
+    return 0;
+  }
+
+  if (interface->cache.sets > 0)
+    updateLines(interface, interface->position, buffer, length, true);
+
+  interface->position += length;
+  return length;
+}
+/*----------------------------------------------------------------------------*/
+struct InterfaceProxyStats interfaceProxyGetStats(const void *object)
+{
+  const struct InterfaceProxy * const interface = object;
+
+  return (struct InterfaceProxyStats){
+      .hits = interface->cache.hits,
+      .misses = interface->cache.misses
+  };
 }
 /*----------------------------------------------------------------------------*/
 void interfaceProxySetOffset(void *object, uint64_t offset)
 {
   struct InterfaceProxy * const interface = object;
+
+  waitReadAhead(interface);
+  interface->ahead.valid = false;
   interface->offset = offset;
+
+  if (interface->cache.sets > 0)
+    invalidateLines(interface);
 }
@@ -8,14 +8,56 @@
 #define CORE_INTERFACE_PROXY_H_
 /*----------------------------------------------------------------------------*/
 #include <xcore/interface.h>
+#include <stdbool.h>
 #include <stdint.h>
 /*----------------------------------------------------------------------------*/
+#define INTERFACE_PROXY_CACHE_WAYS  2
+#define INTERFACE_PROXY_SECTOR_SIZE 512
+
+/* Size of the sector cache memory for the specified number of lines */
+#define INTERFACE_PROXY_CACHE_SIZE(lines) \
+    ((lines) * (INTERFACE_PROXY_SECTOR_SIZE + sizeof(struct InterfaceProxyTag)))
+
 extern const struct InterfaceClass * const InterfaceProxy;
 
 struct InterfaceProxyConfig
 {
   /** Mandatory: underlying interface. */
   struct Interface *pipe;
+  /**
+   * Optional: read-ahead buffer. The underlying interface is switched to
+   * the zero-copy mode, the buffer should be accessible by its DMA.
+   */
+  void *buffer;
+  /** Optional: read-ahead buffer length, multiple of the block size. */
+  size_t length;
+  /**
+   * Optional: sector cache memory with lines followed by their tags,
+   * the underlying interface should be able to access it.
+   */
+  void *cache;
+  /** Optional: sector cache memory size in bytes. */
+  size_t cacheSize;
+  /** Optional: free-running timer used to limit the transfer time. */
+  struct Timer *timer;
+  /** Optional: transfer timeout in milliseconds, used with the timer. */
+  uint32_t timeout;
+};
+
+struct InterfaceProxyStats
+{
+  /* Single-sector reads served from the cache */
+  uint32_t hits;
+  /* Single-sector reads loaded into the cache */
+  uint32_t misses;
+};
+
+struct InterfaceProxyTag
+{
+  /* Sector number relative to the offset, UINT32_MAX for empty lines */
+  uint32_t sector;
+  /* Time of the last access for the replacement policy */
+  uint32_t stamp;
 };
 
 struct InterfaceProxy
@@ -24,10 +66,55 @@ struct InterfaceProxy
 
   struct Interface *pipe;
   uint64_t offset;
+  /* Position relative to the offset */
+  uint64_t position;
+  /* Size of the underlying interface, zero when unknown */
+  uint64_t size;
+
+  /* Timer for transfer timeouts, transfers are unlimited without it */
+  struct Timer *timer;
+  /* Transfer timeout in timer ticks */
+  uint32_t timeout;
+
+  /* Read-ahead state, used when the buffer is available */
+  struct
+  {
+    uint8_t *buffer;
+    size_t length;
+
+    /* Position of the buffered block relative to the offset */
+    uint64_t position;
+    /* End of the previous read relative to the offset */
+    uint64_t last;
+    /* Bytes in the buffered block */
+    size_t count;
+
+    /* Transfer of the underlying interface is in progress */
+    volatile bool busy;
+    /* Buffered block is loaded or being loaded */
+    bool valid;
+    /* Transfer timed out, the underlying interface is not used anymore */
+    bool failed;
+  } ahead;
+
+  /* Set-associative write-through cache for single-sector reads */
+  struct
+  {
+    uint8_t *lines;
+    struct InterfaceProxyTag *tags;
+    /* Number of sets */
+    size_t sets;
+    /* Access counter for the replacement policy */
+    uint32_t clock;
+
+    uint32_t hits;
+    uint32_t misses;
+  } cache;
 };
 /*----------------------------------------------------------------------------*/
 BEGIN_DECLS
 
+struct InterfaceProxyStats interfaceProxyGetStats(const void *);
 void interfaceProxySetOffset(void *, uint64_t);
 
 END_DECLS
@@ -0,0 +1,628 @@
+/*
+ * core/metadata.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "metadata.h"
+#include "wav_defs.h"
+#include <xcore/memory.h>
+#include <assert.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+#define ID3V1_LENGTH        128
+#define ID3V1_FIELD_LENGTH  30
+#define ID3V2_HEADER_LENGTH 10
+#define MAX_READ_RETRIES    4
+
+/* Limits for malformed files */
+#define MAX_CHUNK_COUNT     32
+#define MAX_FRAME_COUNT     64
+
+enum
+{
+  ENCODING_LATIN1,
+  ENCODING_UTF16,
+  ENCODING_UTF16BE,
+  ENCODING_UTF8
+};
+
+enum
+{
+  INFO_ID_IART = 0x49415254UL,
+  INFO_ID_INAM = 0x494E414DUL,
+  INFO_ID_IPRD = 0x49505244UL
+};
+
+struct FrameMapping
+{
+  char id[4];
+  enum MetadataField field;
+};
+/*----------------------------------------------------------------------------*/
+static bool appendCodePoint(char *, size_t *, uint32_t);
+static void decodeText(char *, const uint8_t *, size_t, unsigned int);
+static int findFrameField(const uint8_t *, unsigned int);
+static inline bool isFieldEmpty(const char *);
+static bool isValidUtf8(const uint8_t *, size_t);
+static bool readFile(struct FsNode *, FsLength, uint8_t *, size_t, size_t *);
+static bool readTagsID3v1(struct FsNode *, FsLength, uint8_t *,
+    struct MetadataTags *);
+static bool readTagsID3v2(struct FsNode *, FsLength, uint8_t *, size_t,
+    size_t, struct MetadataTags *);
+static bool readTagsWAV(struct FsNode *, FsLength, uint8_t *, size_t,
+    struct MetadataTags *);
+static uint16_t storeString(struct MetadataTable *, const char *);
+/*----------------------------------------------------------------------------*/
+static const struct FrameMapping frameMap[] = {
+    {"TIT2", METADATA_TITLE},
+    {"TPE1", METADATA_ARTIST},
+    {"TALB", METADATA_ALBUM},
+    /* Identifiers of ID3v2.2 tags */
+    {"TT2", METADATA_TITLE},
+    {"TP1", METADATA_ARTIST},
+    {"TAL", METADATA_ALBUM}
+};
+/*----------------------------------------------------------------------------*/
+static bool appendCodePoint(char *field, size_t *length, uint32_t code)
+{
+  uint8_t sequence[4];
+  size_t count;
+
+  if (code < 0x80)
+  {
+    sequence[0] = (uint8_t)code;
+    count = 1;
+  }
+  else if (code < 0x800)
+  {
+    sequence[0] = (uint8_t)(0xC0 | (code >> 6));
+    sequence[1] = (uint8_t)(0x80 | (code & 0x3F));
+    count = 2;
+  }
+  else if (code < 0x10000)
+  {
+    sequence[0] = (uint8_t)(0xE0 | (code >> 12));
+    sequence[1] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+    sequence[2] = (uint8_t)(0x80 | (code & 0x3F));
+    count = 3;
+  }
+  else
+  {
+    sequence[0] = (uint8_t)(0xF0 | (code >> 18));
+    sequence[1] = (uint8_t)(0x80 | ((code >> 12) & 0x3F));
+    sequence[2] = (uint8_t)(0x80 | ((code >> 6) & 0x3F));
+    sequence[3] = (uint8_t)(0x80 | (code & 0x3F));
+    count = 4;
+  }
+
+  /* Incomplete sequences are not stored, space for the terminator is kept */
+  if (*length + count >= METADATA_FIELD_LENGTH)
+    return false;
+
+  memcpy(field + *length, sequence, count);
+  *length += count;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Converts text to UTF-8. Conversion stops at the first terminator, so only
+ * the first string of a multi-string frame is used. Trailing spaces used as
+ * padding in ID3v1 tags are removed.
+ */
+static void decodeText(char *field, const uint8_t *data, size_t count,
+    unsigned int encoding)
+{
+  size_t length = 0;
+
+  if (encoding == ENCODING_UTF16 || encoding == ENCODING_UTF16BE)
+  {
+    bool big = true;
+
+    if (encoding == ENCODING_UTF16 && count >= 2)
+    {
+      if (data[0] == 0xFF && data[1] == 0xFE)
+      {
+        big = false;
+        data += 2;
+        count -= 2;
+      }
+      else if (data[0] == 0xFE && data[1] == 0xFF)
+      {
+        data += 2;
+        count -= 2;
+      }
+    }
+
+    for (size_t i = 0; i + 1 < count; i += 2)
+    {
+      uint32_t code = big ?
+          ((uint32_t)data[i] << 8 | data[i + 1]) :
+          ((uint32_t)data[i + 1] << 8 | data[i]);
+
+      if (!code)
+        break;
+
+      if (code >= 0xD800 && code < 0xDC00 && i + 3 < count)
+      {
+        /* Surrogate pair */
+        const uint32_t low = big ?
+            ((uint32_t)data[i + 2] << 8 | data[i + 3]) :
+            ((uint32_t)data[i + 3] << 8 | data[i + 2]);
+
+        if (low < 0xDC00 || low >= 0xE000)
+          continue;
+
+        code = 0x10000 + ((code - 0xD800) << 10) + (low - 0xDC00);
+        i += 2;
+      }
+      else if (code >= 0xD800 && code < 0xE000)
+        continue;
+
+      if (!appendCodePoint(field, &length, code))
+        break;
+    }
+  }
+  else
+  {
+    const uint8_t * const end = memchr(data, 0, count);
+
+    if (end != NULL)
+      count = (size_t)(end - data);
+
+    /* Text of ID3v1 tags and RIFF chunks is UTF-8 or Latin-1 */
+    if (encoding == ENCODING_LATIN1 && isValidUtf8(data, count))
+      encoding = ENCODING_UTF8;
+
+    for (size_t i = 0; i < count; ++i)
+    {
+      if (encoding == ENCODING_UTF8 && data[i] >= 0x80)
+      {
+        /* Copy the whole sequence or nothing */
+        size_t next = i + 1;
+
+        while (next < count && (data[next] & 0xC0) == 0x80)
+          ++next;
+
+        if (length + (next - i) >= METADATA_FIELD_LENGTH)
+          break;
+
+        memcpy(field + length, data + i, next - i);
+        length += next - i;
+        i = next - 1;
+      }
+      else if (!appendCodePoint(field, &length, data[i]))
+        break;
+    }
+  }
+
+  while (length && field[length - 1] == ' ')
+    --length;
+
+  field[length] = '\0';
+}
+/*----------------------------------------------------------------------------*/
+static int findFrameField(const uint8_t *id, unsigned int length)
+{
+  for (size_t i = 0; i < ARRAY_SIZE(frameMap); ++i)
+  {
+    if (!memcmp(frameMap[i].id, id, length)
+        && (length == sizeof(frameMap[i].id) || !frameMap[i].id[length]))
+    {
+      return frameMap[i].field;
+    }
+  }
+
+  return -1;
+}
+/*----------------------------------------------------------------------------*/
+static inline bool isFieldEmpty(const char *field)
+{
+  return field[0] == '\0';
+}
+/*----------------------------------------------------------------------------*/
+static bool isValidUtf8(const uint8_t *data, size_t count)
+{
+  size_t i = 0;
+
+  while (i < count)
+  {
+    const uint8_t value = data[i++];
+    size_t continuation;
+
+    if (value < 0x80)
+      continuation = 0;
+    else if ((value & 0xE0) == 0xC0)
+      continuation = 1;
+    else if ((value & 0xF0) == 0xE0)
+      continuation = 2;
+    else if ((value & 0xF8) == 0xF0)
+      continuation = 3;
+    else
+      return false;
+
+    if (continuation > count - i)
+      return false;
+
+    for (; continuation; --continuation)
+    {
+      if ((data[i++] & 0xC0) != 0x80)
+        return false;
+    }
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readFile(struct FsNode *node, FsLength position, uint8_t *buffer,
+    size_t size, size_t *count)
+{
+  enum Result res;
+
+  for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
+  {
+    res = fsNodeRead(node, FS_NODE_DATA, position, buffer, size, count);
+
+    if (res == E_OK)
+      break;
+  }
+
+  return res == E_OK;
+}
+/*----------------------------------------------------------------------------*/
+static bool readTagsID3v1(struct FsNode *node, FsLength length,
+    uint8_t *buffer, struct MetadataTags *tags)
+{
+  size_t count;
+
+  if (length < ID3V1_LENGTH)
+    return true;
+  if (!readFile(node, length - ID3V1_LENGTH, buffer, ID3V1_LENGTH, &count))
+    return false;
+  if (count != ID3V1_LENGTH || memcmp(buffer, "TAG", 3))
+    return true;
+
+  /* Title, artist and album fields follow the identifier */
+  for (size_t i = 0; i < METADATA_FIELD_COUNT; ++i)
+  {
+    if (isFieldEmpty(tags->fields[i]))
+    {
+      decodeText(tags->fields[i], buffer + 3 + i * ID3V1_FIELD_LENGTH,
+          ID3V1_FIELD_LENGTH, ENCODING_LATIN1);
+    }
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readTagsID3v2(struct FsNode *node, FsLength length,
+    uint8_t *buffer, size_t size, size_t count, struct MetadataTags *tags)
+{
+  const uint8_t version = buffer[3];
+  const uint8_t flags = buffer[5];
+
+  if (version < 2 || version > 4)
+    return true;
+  /* Compression flag in ID3v2.2 tags */
+  if (version == 2 && (flags & 0x40))
+    return true;
+
+  const FsLength end = MIN(length, ID3V2_HEADER_LENGTH
+      + (((FsLength)(buffer[6] & 0x7F) << 21)
+      | ((FsLength)(buffer[7] & 0x7F) << 14)
+      | ((FsLength)(buffer[8] & 0x7F) << 7) | (buffer[9] & 0x7F)));
+  const size_t headerLength = version == 2 ? 6 : 10;
+  const size_t idLength = version == 2 ? 3 : 4;
+
+  /* File position of the buffered data */
+  FsLength position = 0;
+  /* Position of the current frame header */
+  FsLength frame = ID3V2_HEADER_LENGTH;
+
+  if (version > 2 && (flags & 0x40))
+  {
+    const uint8_t * const extended = buffer + ID3V2_HEADER_LENGTH;
+
+    if (count < ID3V2_HEADER_LENGTH + 4)
+      return true;
+
+    if (version == 3)
+    {
+      /* Size of the extended header excludes the size field */
+      frame += 4 + (((FsLength)extended[0] << 24)
+          | ((FsLength)extended[1] << 16)
+          | ((FsLength)extended[2] << 8) | extended[3]);
+    }
+    else
+    {
+      frame += ((FsLength)(extended[0] & 0x7F) << 21)
+          | ((FsLength)(extended[1] & 0x7F) << 14)
+          | ((FsLength)(extended[2] & 0x7F) << 7) | (extended[3] & 0x7F);
+    }
+  }
+
+  for (size_t index = 0; index < MAX_FRAME_COUNT; ++index)
+  {
+    if (frame + headerLength > end)
+      break;
+
+    if (frame + headerLength > position + count)
+    {
+      /* Frame header is outside of the buffer, read a next part */
+      position = frame;
+
+      if (!readFile(node, position, buffer, size, &count))
+        return false;
+      if (count < headerLength)
+        break;
+    }
+
+    const uint8_t * const header = buffer + (frame - position);
+    size_t frameSize;
+
+    /* Padding after the last frame */
+    if (!header[0])
+      break;
+
+    if (version == 2)
+    {
+      frameSize = ((size_t)header[3] << 16) | ((size_t)header[4] << 8)
+          | header[5];
+    }
+    else if (version == 3)
+    {
+      frameSize = ((size_t)header[4] << 24) | ((size_t)header[5] << 16)
+          | ((size_t)header[6] << 8) | header[7];
+    }
+    else
+    {
+      frameSize = ((size_t)(header[4] & 0x7F) << 21)
+          | ((size_t)(header[5] & 0x7F) << 14)
+          | ((size_t)(header[6] & 0x7F) << 7) | (header[7] & 0x7F);
+    }
+
+    const FsLength data = frame + headerLength;
+    const int field = findFrameField(header, idLength);
+
+    /* Compressed, encrypted and grouped frames are skipped */
+    const bool plain = version == 2 || !header[9];
+
+    if (field >= 0 && plain && frameSize > 1 && data + frameSize <= end
+        && isFieldEmpty(tags->fields[field]))
+    {
+      const size_t textSize = MIN(frameSize, size);
+
+      if (data + textSize > position + count)
+      {
+        position = data;
+
+        if (!readFile(node, position, buffer, size, &count))
+          return false;
+      }
+
+      const uint8_t * const text = buffer + (data - position);
+      const size_t available = MIN(textSize, count - (size_t)(data - position));
+
+      if (available > 1)
+        decodeText(tags->fields[field], text + 1, available - 1, text[0]);
+    }
+
+    frame = data + frameSize;
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readTagsWAV(struct FsNode *node, FsLength length,
+    uint8_t *buffer, size_t size, struct MetadataTags *tags)
+{
+  /* Position of the current chunk header */
+  FsLength chunk = sizeof(struct RiffHeader);
+
+  for (size_t index = 0; index < MAX_CHUNK_COUNT; ++index)
+  {
+    struct RiffChunk entry;
+    size_t count;
+
+    if (chunk + sizeof(entry) > length)
+      break;
+    if (!readFile(node, chunk, buffer, size, &count))
+      return false;
+    if (count < sizeof(entry) + sizeof(uint32_t))
+      break;
+
+    memcpy(&entry, buffer, sizeof(entry));
+
+    const uint32_t id = fromBigEndian32(entry.id);
+    const uint32_t chunkSize = fromLittleEndian32(entry.size);
+
+    if (id == RIFF_ID_LIST)
+    {
+      uint32_t type;
+
+      memcpy(&type, buffer + sizeof(entry), sizeof(type));
+
+      if (fromBigEndian32(type) == RIFF_ID_INFO)
+      {
+        /* Only the buffered part of the list is parsed */
+        const size_t end = MIN(count, sizeof(entry) + (size_t)chunkSize);
+        size_t position = sizeof(entry) + sizeof(type);
+
+        while (position + sizeof(entry) <= end)
+        {
+          memcpy(&entry, buffer + position, sizeof(entry));
+
+          const uint32_t infoId = fromBigEndian32(entry.id);
+          const size_t infoSize = fromLittleEndian32(entry.size);
+          const size_t available = MIN(infoSize,
+              end - position - sizeof(entry));
+          int field = -1;
+
+          if (infoId == INFO_ID_INAM)
+            field = METADATA_TITLE;
+          else if (infoId == INFO_ID_IART)
+            field = METADATA_ARTIST;
+          else if (infoId == INFO_ID_IPRD)
+            field = METADATA_ALBUM;
+
+          if (field >= 0 && isFieldEmpty(tags->fields[field]))
+          {
+            decodeText(tags->fields[field], buffer + position + sizeof(entry),
+                available, ENCODING_LATIN1);
+          }
+
+          /* Sub-chunk that ends after the buffered part is the last one */
+          if (infoSize > end - position - sizeof(entry))
+            break;
+
+          position += sizeof(entry) + infoSize + (infoSize & 1);
+        }
+
+        break;
+      }
+    }
+
+    /* Skip "fmt ", "data" and other chunks */
+    chunk += sizeof(entry) + chunkSize + (chunkSize & 1);
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static uint16_t storeString(struct MetadataTable *table, const char *string)
+{
+  if (isFieldEmpty(string))
+    return METADATA_STRING_NONE;
+
+  const size_t length = strlen(string) + 1;
+  size_t offset = 0;
+
+  /* Equal strings share one copy in the pool */
+  while (offset < table->used)
+  {
+    const char * const entry = table->pool + offset;
+    const size_t entryLength = strlen(entry) + 1;
+
+    if (entryLength == length && !memcmp(entry, string, length))
+      return (uint16_t)offset;
+
+    offset += entryLength;
+  }
+
+  if (length > table->capacity - table->used)
+    return METADATA_STRING_NONE;
+
+  memcpy(table->pool + table->used, string, length);
+  table->used += length;
+
+  return (uint16_t)offset;
+}
+/*----------------------------------------------------------------------------*/
+void metadataTableInit(struct MetadataTable *table, void *entries,
+    size_t count, void *pool, size_t capacity)
+{
+  assert(entries != NULL && pool != NULL);
+  assert(capacity <= METADATA_STRING_NONE);
+
+  table->entries = entries;
+  table->count = count;
+  table->pool = pool;
+  table->capacity = capacity;
+
+  metadataTableReset(table);
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the entry of the track or NULL when the entry is not filled yet */
+const struct TrackMetadata *metadataTableAt(const struct MetadataTable *table,
+    size_t index)
+{
+  if (index < table->count && table->entries[index].valid)
+    return &table->entries[index];
+  else
+    return NULL;
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the text field of the entry or NULL when the field is missing */
+const char *metadataTableGetString(const struct MetadataTable *table,
+    const struct TrackMetadata *entry, enum MetadataField field)
+{
+  const uint16_t offset = entry->fields[field];
+
+  return offset != METADATA_STRING_NONE ? table->pool + offset : NULL;
+}
+/*----------------------------------------------------------------------------*/
+void metadataTableReset(struct MetadataTable *table)
+{
+  table->used = 0;
+
+  for (size_t i = 0; i < table->count; ++i)
+    table->entries[i].valid = false;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Fills the entry of the track. Fields that do not fit into the string pool
+ * are left empty.
+ */
+void metadataTableStore(struct MetadataTable *table, size_t index,
+    const struct MetadataTags *tags, uint32_t duration)
+{
+  if (index >= table->count)
+    return;
+
+  struct TrackMetadata * const entry = &table->entries[index];
+
+  for (size_t i = 0; i < METADATA_FIELD_COUNT; ++i)
+    entry->fields[i] = storeString(table, tags->fields[i]);
+
+  entry->duration = duration;
+  entry->valid = true;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Extracts title, artist and album from ID3v2 and ID3v1 tags or from the
+ * "LIST/INFO" chunk of WAV files. The buffer is used for file reads, missing
+ * fields are returned as empty strings.
+ */
+bool metadataReadTags(struct FsNode *node, uint8_t *buffer, size_t size,
+    struct MetadataTags *tags)
+{
+  FsLength length;
+  size_t count;
+
+  assert(size >= ID3V1_LENGTH);
+
+  for (size_t i = 0; i < METADATA_FIELD_COUNT; ++i)
+    tags->fields[i][0] = '\0';
+
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK)
+    return false;
+  if (!readFile(node, 0, buffer, size, &count))
+    return false;
+
+  if (count >= sizeof(struct RiffHeader))
+  {
+    struct RiffHeader header;
+
+    memcpy(&header, buffer, sizeof(header));
+
+    if (fromBigEndian32(header.id) == RIFF_ID_RIFF
+        && fromBigEndian32(header.format) == RIFF_ID_WAVE)
+    {
+      return readTagsWAV(node, length, buffer, size, tags);
+    }
+  }
+
+  if (count >= ID3V2_HEADER_LENGTH && !memcmp(buffer, "ID3", 3))
+  {
+    if (!readTagsID3v2(node, length, buffer, size, count, tags))
+      return false;
+  }
+
+  bool missing = false;
+
+  for (size_t i = 0; i < METADATA_FIELD_COUNT; ++i)
+    missing = missing || isFieldEmpty(tags->fields[i]);
+
+  /* Fields missing in the ID3v2 tag are taken from the ID3v1 tag */
+  return missing ? readTagsID3v1(node, length, buffer, tags) : true;
+}
@@ -0,0 +1,77 @@
+/*
+ * core/metadata.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_METADATA_H_
+#define CORE_METADATA_H_
+/*----------------------------------------------------------------------------*/
+#include <xcore/fs/fs.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+/* Maximum length of an extracted text field including the terminator */
+#define METADATA_FIELD_LENGTH 64
+/* Offset of a missing string in the string pool */
+#define METADATA_STRING_NONE  UINT16_MAX
+
+enum [[gnu::packed]] MetadataField
+{
+  METADATA_TITLE,
+  METADATA_ARTIST,
+  METADATA_ALBUM,
+
+  METADATA_FIELD_COUNT
+};
+
+/* Text fields extracted from tags of one file, empty strings when missing */
+struct MetadataTags
+{
+  char fields[METADATA_FIELD_COUNT][METADATA_FIELD_LENGTH];
+};
+
+struct TrackMetadata
+{
+  /* Duration in milliseconds, zero when unknown */
+  uint32_t duration;
+  /* Offsets of UTF-8 strings in the string pool */
+  uint16_t fields[METADATA_FIELD_COUNT];
+  /* Entry is filled */
+  bool valid;
+};
+
+/*
+ * Side table with one entry for each track of the track list. Strings of all
+ * entries are stored in a shared pool, equal strings are stored once, so
+ * repeated artist and album names take no additional space.
+ */
+struct MetadataTable
+{
+  struct TrackMetadata *entries;
+  size_t count;
+
+  char *pool;
+  size_t capacity;
+  /* Bytes used in the string pool */
+  size_t used;
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+void metadataTableInit(struct MetadataTable *, void *, size_t, void *, size_t);
+const struct TrackMetadata *metadataTableAt(const struct MetadataTable *,
+    size_t);
+const char *metadataTableGetString(const struct MetadataTable *,
+    const struct TrackMetadata *, enum MetadataField);
+void metadataTableReset(struct MetadataTable *);
+void metadataTableStore(struct MetadataTable *, size_t,
+    const struct MetadataTags *, uint32_t);
+
+bool metadataReadTags(struct FsNode *, uint8_t *, size_t,
+    struct MetadataTags *);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_METADATA_H_ */
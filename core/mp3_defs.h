@@ -0,0 +1,52 @@
+/*
+ * core/mp3_defs.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_MP3_DEFS_H_
+#define CORE_MP3_DEFS_H_
+/*----------------------------------------------------------------------------*/
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+/* Delay of the synthesis filter bank of Layer III decoders in samples */
+#define MP3_DECODER_DELAY 529
+
+enum
+{
+  XING_FLAG_FRAMES  = 0x00000001UL,
+  XING_FLAG_BYTES   = 0x00000002UL,
+  XING_FLAG_TOC     = 0x00000004UL,
+  XING_FLAG_QUALITY = 0x00000008UL
+};
+
+/* Tag in the first frame of VBR and LAME encoded streams */
+struct [[gnu::packed]] XingHeader
+{
+  /* The "Xing" or "Info" identifier */
+  uint32_t id;
+  uint32_t flags;
+};
+
+/* Extension of the Xing header placed after its optional fields */
+struct [[gnu::packed]] LameHeader
+{
+  char encoder[9];
+  uint8_t revision;
+  uint8_t lowpass;
+  uint32_t peak;
+  uint16_t radioGain;
+  uint16_t audiophileGain;
+  uint8_t encodingFlags;
+  uint8_t bitrate;
+  /* Encoder delay and padding, 12 bits each */
+  uint8_t delay[3];
+  uint8_t misc;
+  uint8_t gain;
+  uint16_t preset;
+  uint32_t length;
+  uint16_t musicCRC;
+  uint16_t tagCRC;
+};
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_MP3_DEFS_H_ */
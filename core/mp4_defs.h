@@ -0,0 +1,57 @@
+/*
+ * core/mp4_defs.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_MP4_DEFS_H_
+#define CORE_MP4_DEFS_H_
+/*----------------------------------------------------------------------------*/
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+/* Length of the ADTS frame header without the checksum */
+#define ADTS_HEADER_LENGTH      7
+
+enum
+{
+  MP4_BOX_CO64  = 0x636F3634UL,
+  MP4_BOX_ESDS  = 0x65736473UL,
+  MP4_BOX_FTYP  = 0x66747970UL,
+  MP4_BOX_HDLR  = 0x68646C72UL,
+  MP4_BOX_MDHD  = 0x6D646864UL,
+  MP4_BOX_MDIA  = 0x6D646961UL,
+  MP4_BOX_MINF  = 0x6D696E66UL,
+  MP4_BOX_MOOV  = 0x6D6F6F76UL,
+  MP4_BOX_MP4A  = 0x6D703461UL,
+  MP4_BOX_STBL  = 0x7374626CUL,
+  MP4_BOX_STCO  = 0x7374636FUL,
+  MP4_BOX_STSC  = 0x73747363UL,
+  MP4_BOX_STSD  = 0x73747364UL,
+  MP4_BOX_STSZ  = 0x7374737AUL,
+  MP4_BOX_TRAK  = 0x7472616BUL
+};
+
+/* Handler type of audio tracks */
+#define MP4_HANDLER_SOUN        0x736F756EUL
+
+/* Descriptor tags of the "esds" box */
+enum
+{
+  MP4_TAG_ES              = 0x03,
+  MP4_TAG_DECODER_CONFIG  = 0x04,
+  MP4_TAG_DECODER_INFO    = 0x05
+};
+
+/* Object type indication of MPEG-4 audio streams */
+#define MP4_OBJECT_AUDIO        0x40
+/* Audio object type of AAC Low Complexity streams */
+#define MP4_AUDIO_OBJECT_AAC_LC 2
+
+/* Header of each box, 64-bit box size follows when the size field is 1 */
+struct [[gnu::packed]] Mp4Box
+{
+  uint32_t size;
+  uint32_t type;
+};
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_MP4_DEFS_H_ */
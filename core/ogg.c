@@ -0,0 +1,283 @@
+/*
+ * core/ogg.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "ogg.h"
+#include <xcore/memory.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+#define CAPTURE_PATTERN "OggS"
+#define CAPTURE_LENGTH  4
+/*----------------------------------------------------------------------------*/
+static void finishPage(struct OggReader *);
+static bool readInput(struct OggReader *);
+static enum OggStatus readPageHeader(struct OggReader *);
+static void startPage(struct OggReader *);
+/*----------------------------------------------------------------------------*/
+static void finishPage(struct OggReader *reader)
+{
+  reader->body = false;
+  reader->collected = 0;
+
+  if (reader->foreign || reader->granule == OGG_GRANULE_UNKNOWN)
+    return;
+
+  reader->previous = reader->granule;
+
+  /* Skipping ends when no packet continues on the next page */
+  if (reader->skip && !reader->length && !reader->drop)
+    reader->skip = false;
+}
+/*----------------------------------------------------------------------------*/
+static bool readInput(struct OggReader *reader)
+{
+  if (reader->error)
+    return false;
+
+  if (!reader->fill(reader->argument, &reader->data, &reader->size))
+  {
+    reader->error = true;
+    reader->size = 0;
+    return false;
+  }
+
+  return reader->size > 0;
+}
+/*----------------------------------------------------------------------------*/
+static enum OggStatus readPageHeader(struct OggReader *reader)
+{
+  while (1)
+  {
+    const size_t required = reader->collected < OGG_PAGE_HEADER_LENGTH ?
+        OGG_PAGE_HEADER_LENGTH :
+        OGG_PAGE_HEADER_LENGTH + reader->header[OGG_PAGE_HEADER_LENGTH - 1];
+
+    if (reader->collected == required)
+      break;
+
+    if (!reader->size && !readInput(reader))
+      return reader->error ? OGG_ERROR : OGG_END;
+
+    if (reader->collected < CAPTURE_LENGTH)
+    {
+      /* Search for the capture pattern byte by byte */
+      const uint8_t value = *reader->data++;
+
+      --reader->size;
+
+      if (value == (uint8_t)CAPTURE_PATTERN[reader->collected])
+        reader->header[reader->collected++] = value;
+      else
+        reader->collected = value == (uint8_t)CAPTURE_PATTERN[0] ? 1 : 0;
+
+      continue;
+    }
+
+    const size_t chunk = MIN(required - reader->collected, reader->size);
+
+    memcpy(reader->header + reader->collected, reader->data, chunk);
+    reader->collected += chunk;
+    reader->data += chunk;
+    reader->size -= chunk;
+
+    if (reader->collected == OGG_PAGE_HEADER_LENGTH
+        && reader->header[CAPTURE_LENGTH] != 0)
+    {
+      /* Unsupported stream structure version, continue the search */
+      reader->collected = 0;
+    }
+  }
+
+  startPage(reader);
+  return OGG_OK;
+}
+/*----------------------------------------------------------------------------*/
+static void startPage(struct OggReader *reader)
+{
+  struct OggPageHeader header;
+
+  memcpy(&header, reader->header, sizeof(header));
+
+  reader->body = true;
+  reader->foreign = fromLittleEndian32(header.serial) != reader->serial;
+  reader->segments = header.segments;
+  reader->segment = 0;
+  reader->left = header.segments ?
+      reader->header[OGG_PAGE_HEADER_LENGTH] : 0;
+
+  if (reader->foreign)
+    return;
+
+  reader->granule = fromLittleEndian64(header.granule);
+
+  if (header.flags & OGG_PAGE_CONTINUED)
+  {
+    /* Beginning of the continued packet is missing */
+    if (!reader->length)
+      reader->drop = true;
+  }
+  else if (reader->length || reader->drop)
+  {
+    /* Previous page was lost, the unfinished packet is dropped */
+    reader->length = 0;
+    reader->drop = false;
+  }
+}
+/*----------------------------------------------------------------------------*/
+void oggReaderInit(struct OggReader *reader,
+    bool (*fill)(void *, const uint8_t **, size_t *), void *argument,
+    uint8_t *packet, size_t capacity)
+{
+  reader->fill = fill;
+  reader->argument = argument;
+  reader->packet = packet;
+  reader->capacity = capacity;
+
+  oggReaderReset(reader, 0, false);
+}
+/*----------------------------------------------------------------------------*/
+/* Returns the granule position before the first sample of the last packet */
+uint64_t oggReaderGetOrigin(const struct OggReader *reader)
+{
+  return reader->origin;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Reads a next packet of the selected logical stream. Returned data remains
+ * valid until the next call.
+ */
+enum OggStatus oggReaderRead(struct OggReader *reader, const uint8_t **packet,
+    size_t *length)
+{
+  while (1)
+  {
+    if (!reader->body)
+    {
+      const enum OggStatus status = readPageHeader(reader);
+
+      if (status != OGG_OK)
+        return status;
+    }
+
+    if (reader->segment == reader->segments)
+    {
+      finishPage(reader);
+      continue;
+    }
+
+    if (reader->left)
+    {
+      if (!reader->size && !readInput(reader))
+        return reader->error ? OGG_ERROR : OGG_END;
+
+      const size_t chunk = MIN(reader->left, reader->size);
+
+      if (!reader->foreign && !reader->drop)
+      {
+        if (!reader->length)
+          reader->origin = reader->previous;
+
+        if (reader->length + chunk <= reader->capacity)
+          memcpy(reader->packet + reader->length, reader->data, chunk);
+        else
+          reader->drop = true;
+
+        reader->length += chunk;
+      }
+
+      reader->data += chunk;
+      reader->size -= chunk;
+      reader->left -= chunk;
+
+      if (reader->left)
+        continue;
+    }
+
+    /* Segment is complete, packet ends on a segment shorter than 255 bytes */
+    const uint8_t lacing = reader->header[OGG_PAGE_HEADER_LENGTH
+        + reader->segment];
+
+    if (++reader->segment < reader->segments)
+    {
+      reader->left = reader->header[OGG_PAGE_HEADER_LENGTH
+          + reader->segment];
+    }
+
+    if (reader->foreign || lacing == 255)
+      continue;
+
+    const bool valid = !reader->drop && !reader->skip;
+
+    *length = reader->length;
+    reader->length = 0;
+    reader->drop = false;
+
+    if (valid)
+    {
+      *packet = reader->packet;
+      return OGG_OK;
+    }
+  }
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Selects the logical stream and discards buffered input. When skipping is
+ * enabled, packets are dropped until the first page with a known granule
+ * position ends, so the origin of the following packets is known.
+ */
+void oggReaderReset(struct OggReader *reader, uint32_t serial, bool skip)
+{
+  reader->data = NULL;
+  reader->size = 0;
+  reader->length = 0;
+
+  reader->granule = 0;
+  reader->previous = 0;
+  reader->origin = 0;
+  reader->serial = serial;
+
+  reader->collected = 0;
+  reader->left = 0;
+  reader->segments = 0;
+  reader->segment = 0;
+
+  reader->body = false;
+  reader->foreign = false;
+  reader->drop = false;
+  reader->skip = skip;
+  reader->error = false;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Parses a page header with the segment table. Returns the total length of
+ * the page including page data.
+ */
+bool oggParsePageHeader(const uint8_t *data, size_t available,
+    struct OggPageHeader *header, size_t *length)
+{
+  if (available < OGG_PAGE_HEADER_LENGTH)
+    return false;
+  if (memcmp(data, CAPTURE_PATTERN, CAPTURE_LENGTH) || data[CAPTURE_LENGTH])
+    return false;
+
+  memcpy(header, data, sizeof(*header));
+
+  if (available < OGG_PAGE_HEADER_LENGTH + (size_t)header->segments)
+    return false;
+
+  size_t total = OGG_PAGE_HEADER_LENGTH + header->segments;
+
+  for (size_t i = 0; i < header->segments; ++i)
+    total += data[OGG_PAGE_HEADER_LENGTH + i];
+
+  header->capture = fromLittleEndian32(header->capture);
+  header->granule = fromLittleEndian64(header->granule);
+  header->serial = fromLittleEndian32(header->serial);
+  header->sequence = fromLittleEndian32(header->sequence);
+  header->checksum = fromLittleEndian32(header->checksum);
+
+  *length = total;
+  return true;
+}
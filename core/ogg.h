@@ -0,0 +1,110 @@
+/*
+ * core/ogg.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_OGG_H_
+#define CORE_OGG_H_
+/*----------------------------------------------------------------------------*/
+#include <xcore/helpers.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+/* Length of the page header without the segment table */
+#define OGG_PAGE_HEADER_LENGTH  27
+/* Maximum number of segments in one page */
+#define OGG_MAX_SEGMENTS        255
+/* Granule position of pages without completed packets */
+#define OGG_GRANULE_UNKNOWN     UINT64_MAX
+
+enum
+{
+  OGG_PAGE_CONTINUED  = 0x01,
+  OGG_PAGE_FIRST      = 0x02,
+  OGG_PAGE_LAST       = 0x04
+};
+
+enum [[gnu::packed]] OggStatus
+{
+  OGG_OK,
+  OGG_END,
+  OGG_ERROR
+};
+
+struct [[gnu::packed]] OggPageHeader
+{
+  /* The "OggS" capture pattern */
+  uint32_t capture;
+  uint8_t version;
+  uint8_t flags;
+  uint64_t granule;
+  uint32_t serial;
+  uint32_t sequence;
+  uint32_t checksum;
+  uint8_t segments;
+};
+
+struct OggReader
+{
+  /* Input callback, it returns an empty chunk at the end of the stream */
+  bool (*fill)(void *, const uint8_t **, size_t *);
+  void *argument;
+
+  /* Unread input data */
+  const uint8_t *data;
+  size_t size;
+
+  /* Buffer for packets spanning several segments or pages */
+  uint8_t *packet;
+  size_t capacity;
+  /* Assembled length of the current packet */
+  size_t length;
+
+  /* Granule position of the current page */
+  uint64_t granule;
+  /* Granule position of the last page with completed packets */
+  uint64_t previous;
+  /* Granule position before the first sample of the last packet */
+  uint64_t origin;
+  /* Serial number of the selected logical stream */
+  uint32_t serial;
+
+  /* Number of collected bytes of the page header and the segment table */
+  size_t collected;
+  /* Bytes left in the current segment */
+  size_t left;
+  /* Segment count of the current page */
+  uint8_t segments;
+  /* Index of the current segment */
+  uint8_t segment;
+
+  /* Page header is parsed, segments of the page are being read */
+  bool body;
+  /* Current page belongs to another logical stream */
+  bool foreign;
+  /* Current packet is incomplete or too long and will be dropped */
+  bool drop;
+  /* Packets are dropped until a page with a known granule position ends */
+  bool skip;
+  /* Input callback failed */
+  bool error;
+
+  /* Page header followed by the segment table */
+  uint8_t header[OGG_PAGE_HEADER_LENGTH + OGG_MAX_SEGMENTS];
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+void oggReaderInit(struct OggReader *,
+    bool (*)(void *, const uint8_t **, size_t *), void *, uint8_t *, size_t);
+uint64_t oggReaderGetOrigin(const struct OggReader *);
+enum OggStatus oggReaderRead(struct OggReader *, const uint8_t **, size_t *);
+void oggReaderReset(struct OggReader *, uint32_t, bool);
+bool oggParsePageHeader(const uint8_t *, size_t, struct OggPageHeader *,
+    size_t *);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_OGG_H_ */
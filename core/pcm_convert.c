@@ -0,0 +1,389 @@
+/*
+ * core/pcm_convert.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "pcm_convert.h"
+#include <assert.h>
+#include <stdbool.h>
+
+#ifdef __ARM_FEATURE_SIMD32
+#  include <arm_acle.h>
+#endif
+/*----------------------------------------------------------------------------*/
+struct Kernel
+{
+  /* Conversion function for whole groups of frames */
+  void (*convert)(uint32_t *, size_t);
+  /* Frames in a group */
+  uint8_t group;
+  /* Output is longer than input */
+  bool expand;
+};
+/*----------------------------------------------------------------------------*/
+static inline void convertFrame(uint8_t *, size_t, unsigned int,
+    unsigned int);
+static inline uint32_t packHigh(uint32_t, uint32_t);
+static inline uint32_t packLow(uint32_t, uint32_t);
+static inline uint32_t readSample(const uint8_t *, unsigned int);
+static inline void writeFrame(uint8_t *, uint32_t, uint32_t);
+
+#if PCM_OUTPUT_WIDTH == 16
+static inline uint32_t spreadEvenBytes(uint32_t);
+#endif
+
+static void convertS16Mono(uint32_t *, size_t);
+static void convertS24Mono(uint32_t *, size_t);
+static void convertS24Stereo(uint32_t *, size_t);
+static void convertS32Mono(uint32_t *, size_t);
+static void convertU8Mono(uint32_t *, size_t);
+static void convertU8Stereo(uint32_t *, size_t);
+
+#if PCM_OUTPUT_WIDTH == 16
+static void convertS32Stereo(uint32_t *, size_t);
+#else
+static void convertS16Stereo(uint32_t *, size_t);
+#endif
+/*----------------------------------------------------------------------------*/
+/* Kernels indexed by sample width in bytes and channel count */
+#if PCM_OUTPUT_WIDTH == 16
+static const struct Kernel kernels[4][2] = {
+    {
+        {convertU8Mono, 4, true},
+        {convertU8Stereo, 2, true}
+    }, {
+        {convertS16Mono, 2, true},
+        {NULL, 1, false}
+    }, {
+        {convertS24Mono, 4, true},
+        {convertS24Stereo, 2, false}
+    }, {
+        {convertS32Mono, 1, false},
+        {convertS32Stereo, 1, false}
+    }
+};
+#else
+static const struct Kernel kernels[4][2] = {
+    {
+        {convertU8Mono, 4, true},
+        {convertU8Stereo, 2, true}
+    }, {
+        {convertS16Mono, 2, true},
+        {convertS16Stereo, 1, true}
+    }, {
+        {convertS24Mono, 4, true},
+        {convertS24Stereo, 2, true}
+    }, {
+        {convertS32Mono, 1, true},
+        {NULL, 1, false}
+    }
+};
+#endif
+/*----------------------------------------------------------------------------*/
+static inline void convertFrame(uint8_t *buffer, size_t index,
+    unsigned int width, unsigned int channels)
+{
+  const uint8_t * const input = buffer + index * width * channels;
+  const uint32_t left = readSample(input, width);
+  const uint32_t right = channels > 1 ? readSample(input + width, width) : left;
+
+  writeFrame(buffer + index * PCM_FRAME_SIZE, left, right);
+}
+/*----------------------------------------------------------------------------*/
+/* Packs the upper half of the first value above the upper half of the second */
+static inline uint32_t packHigh(uint32_t high, uint32_t low)
+{
+#ifdef __ARM_FEATURE_SIMD32
+  uint32_t result;
+
+  __asm__ ("pkhtb %0, %1, %2, asr #16"
+      : "=r" (result)
+      : "r" (high), "r" (low));
+  return result;
+#else
+  return (high & 0xFFFF0000UL) | (low >> 16);
+#endif
+}
+/*----------------------------------------------------------------------------*/
+/* Packs the lower half of the second value above the lower half of the first */
+static inline uint32_t packLow(uint32_t low, uint32_t high)
+{
+#ifdef __ARM_FEATURE_SIMD32
+  uint32_t result;
+
+  __asm__ ("pkhbt %0, %1, %2, lsl #16"
+      : "=r" (result)
+      : "r" (low), "r" (high));
+  return result;
+#else
+  return (low & 0x0000FFFFUL) | (high << 16);
+#endif
+}
+/*----------------------------------------------------------------------------*/
+/* Returns a little-endian sample aligned to the most significant bit */
+static inline uint32_t readSample(const uint8_t *input, unsigned int width)
+{
+  uint32_t value = 0;
+
+  for (unsigned int i = 0; i < width; ++i)
+    value = (value >> 8) | ((uint32_t)input[i] << 24);
+
+  /* Unsigned samples are converted to signed ones by inverting the MSB */
+  return width == 1 ? value ^ 0x80000000UL : value;
+}
+/*----------------------------------------------------------------------------*/
+static inline void writeFrame(uint8_t *output, uint32_t left, uint32_t right)
+{
+#if PCM_OUTPUT_WIDTH == 16
+  *(uint32_t *)output = packHigh(right, left);
+#else
+  ((uint32_t *)output)[0] = left;
+  ((uint32_t *)output)[1] = right;
+#endif
+}
+/*----------------------------------------------------------------------------*/
+#if PCM_OUTPUT_WIDTH == 16
+/* Moves bytes 0 and 2 to the upper bytes of the corresponding halfwords */
+static inline uint32_t spreadEvenBytes(uint32_t value)
+{
+#ifdef __ARM_FEATURE_SIMD32
+  return __uxtb16(value) << 8;
+#else
+  return (value & 0x00FF00FFUL) << 8;
+#endif
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#if PCM_OUTPUT_WIDTH == 16
+static void convertS16Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t value = buffer[i];
+    uint32_t * const output = buffer + i * 2;
+
+    output[0] = packLow(value, value);
+    output[1] = packHigh(value, value);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS24Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t * const input = buffer + i * 3;
+    const uint32_t a = input[0] >> 8;
+    const uint32_t b = input[1];
+    const uint32_t c = (input[1] >> 24) | (input[2] << 8);
+    const uint32_t d = input[2];
+    uint32_t * const output = buffer + i * 4;
+
+    output[0] = packLow(a, a);
+    output[1] = packLow(b, b);
+    output[2] = packLow(c, c);
+    output[3] = packHigh(d, d);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS24Stereo(uint32_t *buffer, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+  {
+    const uint32_t * const input = buffer + i * 3;
+    const uint32_t a = input[0] >> 8;
+    const uint32_t b = input[1];
+    const uint32_t c = (input[1] >> 24) | (input[2] << 8);
+    const uint32_t d = input[2];
+    uint32_t * const output = buffer + i * 2;
+
+    output[0] = packLow(a, b);
+    output[1] = packHigh(d, c << 16);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS32Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    buffer[i] = packHigh(buffer[i], buffer[i]);
+}
+/*----------------------------------------------------------------------------*/
+static void convertS32Stereo(uint32_t *buffer, size_t count)
+{
+  for (size_t i = 0; i < count; ++i)
+    buffer[i] = packHigh(buffer[i * 2 + 1], buffer[i * 2]);
+}
+/*----------------------------------------------------------------------------*/
+static void convertU8Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    /* Unsigned samples are converted to signed ones by inverting the MSB */
+    const uint32_t value = buffer[i] ^ 0x80808080UL;
+    const uint32_t even = spreadEvenBytes(value);
+    const uint32_t odd = value & 0xFF00FF00UL;
+    uint32_t * const output = buffer + i * 4;
+
+    output[0] = packLow(even, even);
+    output[1] = packLow(odd, odd);
+    output[2] = packHigh(even, even);
+    output[3] = packHigh(odd, odd);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertU8Stereo(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t value = buffer[i] ^ 0x80808080UL;
+    const uint32_t even = spreadEvenBytes(value);
+    const uint32_t odd = value & 0xFF00FF00UL;
+    uint32_t * const output = buffer + i * 2;
+
+    output[0] = packLow(even, odd);
+    output[1] = packHigh(odd, even);
+  }
+}
+#else
+/*----------------------------------------------------------------------------*/
+static void convertS16Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t value = buffer[i];
+    uint32_t * const output = buffer + i * 4;
+
+    output[0] = output[1] = value << 16;
+    output[2] = output[3] = value & 0xFFFF0000UL;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS16Stereo(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t value = buffer[i];
+    uint32_t * const output = buffer + i * 2;
+
+    output[0] = value << 16;
+    output[1] = value & 0xFFFF0000UL;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS24Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t * const input = buffer + i * 3;
+    const uint32_t a = input[0] << 8;
+    const uint32_t b = ((input[0] >> 16) & 0x0000FF00UL) | (input[1] << 16);
+    const uint32_t c = ((input[1] >> 8) & 0x00FFFF00UL) | (input[2] << 24);
+    const uint32_t d = input[2] & 0xFFFFFF00UL;
+    uint32_t * const output = buffer + i * 8;
+
+    output[0] = output[1] = a;
+    output[2] = output[3] = b;
+    output[4] = output[5] = c;
+    output[6] = output[7] = d;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS24Stereo(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t * const input = buffer + i * 3;
+    const uint32_t a = input[0] << 8;
+    const uint32_t b = ((input[0] >> 16) & 0x0000FF00UL) | (input[1] << 16);
+    const uint32_t c = ((input[1] >> 8) & 0x00FFFF00UL) | (input[2] << 24);
+    const uint32_t d = input[2] & 0xFFFFFF00UL;
+    uint32_t * const output = buffer + i * 4;
+
+    output[0] = a;
+    output[1] = b;
+    output[2] = c;
+    output[3] = d;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertS32Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+    buffer[i * 2] = buffer[i * 2 + 1] = buffer[i];
+}
+/*----------------------------------------------------------------------------*/
+static void convertU8Mono(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    /* Unsigned samples are converted to signed ones by inverting the MSB */
+    const uint32_t value = buffer[i] ^ 0x80808080UL;
+    uint32_t * const output = buffer + i * 8;
+
+    output[0] = output[1] = value << 24;
+    output[2] = output[3] = (value << 16) & 0xFF000000UL;
+    output[4] = output[5] = (value << 8) & 0xFF000000UL;
+    output[6] = output[7] = value & 0xFF000000UL;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void convertU8Stereo(uint32_t *buffer, size_t count)
+{
+  for (size_t i = count; i--;)
+  {
+    const uint32_t value = buffer[i] ^ 0x80808080UL;
+    uint32_t * const output = buffer + i * 4;
+
+    output[0] = value << 24;
+    output[1] = (value << 16) & 0xFF000000UL;
+    output[2] = (value << 8) & 0xFF000000UL;
+    output[3] = value & 0xFF000000UL;
+  }
+}
+#endif
+/*----------------------------------------------------------------------------*/
+/*
+ * Converts little-endian mono or stereo samples with a width from 1 to 4 bytes
+ * to output stereo frames in place and returns the length of the output data.
+ * Samples with a width of 1 byte are unsigned. The word-aligned buffer should
+ * be large enough to hold the converted frames.
+ */
+size_t pcmConvert(void *buffer, size_t length, unsigned int width,
+    unsigned int channels)
+{
+  assert(width >= 1 && width <= 4);
+  assert(channels >= 1 && channels <= 2);
+  assert(((uintptr_t)buffer & (sizeof(uint32_t) - 1)) == 0);
+
+  const struct Kernel * const kernel = &kernels[width - 1][channels - 1];
+  const size_t frame = width * channels;
+  const size_t count = length / frame;
+  const size_t whole = count - count % kernel->group;
+  uint8_t * const data = buffer;
+
+  if (kernel->convert == NULL)
+  {
+    /* Input data is already in the output format */
+  }
+  else if (kernel->expand)
+  {
+    /* Frames are moved towards the end, the last frame is converted first */
+    for (size_t i = count; i > whole;)
+    {
+      --i;
+      convertFrame(data, i, width, channels);
+    }
+
+    kernel->convert(buffer, whole / kernel->group);
+  }
+  else
+  {
+    /* Frames are moved towards the beginning */
+    kernel->convert(buffer, whole / kernel->group);
+
+    for (size_t i = whole; i < count; ++i)
+      convertFrame(data, i, width, channels);
+  }
+
+  return count * PCM_FRAME_SIZE;
+}
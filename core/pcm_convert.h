@@ -0,0 +1,48 @@
+/*
+ * core/pcm_convert.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_PCM_CONVERT_H_
+#define CORE_PCM_CONVERT_H_
+/*----------------------------------------------------------------------------*/
+#include <xcore/helpers.h>
+#include <stddef.h>
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+#ifndef CONFIG_OUTPUT_WIDTH
+#  define PCM_OUTPUT_WIDTH 16
+#else
+#  define PCM_OUTPUT_WIDTH CONFIG_OUTPUT_WIDTH
+#endif
+
+#if PCM_OUTPUT_WIDTH == 16
+typedef int16_t PcmSample;
+#elif PCM_OUTPUT_WIDTH == 32
+typedef int32_t PcmSample;
+#else
+#  error "Unsupported output sample width"
+#endif
+
+/* Output frame with two signed samples aligned to the most significant bit */
+#define PCM_FRAME_SIZE (2 * sizeof(PcmSample))
+/*----------------------------------------------------------------------------*/
+/* Format of the output stream */
+struct PcmFormat
+{
+  /* Sample rate */
+  uint32_t rate;
+  /* Channel count of the source data */
+  uint8_t channels;
+  /* Width of the output samples in bits */
+  uint8_t width;
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+size_t pcmConvert(void *, size_t, unsigned int, unsigned int);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_PCM_CONVERT_H_ */
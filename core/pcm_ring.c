@@ -0,0 +1,130 @@
+/*
+ * core/pcm_ring.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "pcm_ring.h"
+#include <halm/irq.h>
+#include <assert.h>
+#include <string.h>
+/*----------------------------------------------------------------------------*/
+void pcmRingInit(struct PcmRing *ring, void *buffer, size_t size)
+{
+  assert(buffer != NULL && size > 0);
+
+  ring->buffer = buffer;
+  ring->size = size;
+  pcmRingReset(ring);
+}
+/*----------------------------------------------------------------------------*/
+void pcmRingReset(struct PcmRing *ring)
+{
+  ring->head = 0;
+  ring->tail = 0;
+  ring->release = 0;
+  ring->ready = 0;
+  ring->used = 0;
+  ring->split = false;
+}
+/*----------------------------------------------------------------------------*/
+void pcmRingCommit(struct PcmRing *ring, size_t length)
+{
+  if (ring->split)
+  {
+    /* Move the beginning of the chunk to the end of the buffer */
+    const size_t left = ring->size - ring->head;
+
+    memmove(ring->buffer + ring->head, ring->buffer, MIN(length, left));
+    if (length > left)
+      memmove(ring->buffer, ring->buffer + left, length - left);
+  }
+
+  const IrqState state = irqSave();
+
+  assert(ring->used + length <= ring->size);
+
+  ring->head += length;
+  if (ring->head >= ring->size)
+    ring->head -= ring->size;
+
+  ring->ready += length;
+  ring->used += length;
+
+  irqRestore(state);
+}
+/*----------------------------------------------------------------------------*/
+void pcmRingDrop(struct PcmRing *ring)
+{
+  const IrqState state = irqSave();
+
+  ring->used -= ring->ready;
+  ring->ready = 0;
+  ring->head = ring->tail;
+
+  irqRestore(state);
+}
+/*----------------------------------------------------------------------------*/
+void *pcmRingReserve(struct PcmRing *ring, size_t length)
+{
+  assert(length <= ring->size);
+
+  const IrqState state = irqSave();
+  uint8_t *position = NULL;
+
+  if (!ring->used)
+  {
+    /* Ring is empty, restart from the beginning of the buffer */
+    ring->head = 0;
+    ring->tail = 0;
+    ring->release = 0;
+  }
+
+  if (length <= ring->size - ring->used)
+  {
+    if (ring->head + length <= ring->size)
+    {
+      position = ring->buffer + ring->head;
+      ring->split = false;
+    }
+    else if (length <= ring->release)
+    {
+      /*
+       * Chunk is written to the free space at the beginning of the buffer
+       * and is split between the end and the beginning during commit.
+       */
+      position = ring->buffer;
+      ring->split = true;
+    }
+  }
+
+  irqRestore(state);
+  return position;
+}
+/*----------------------------------------------------------------------------*/
+void *pcmRingAcquire(struct PcmRing *ring, size_t length, size_t *count)
+{
+  size_t chunk = MIN(length, ring->ready);
+  chunk = MIN(chunk, ring->size - ring->tail);
+
+  uint8_t * const position = ring->buffer + ring->tail;
+
+  ring->tail += chunk;
+  ring->ready -= chunk;
+  if (ring->tail == ring->size)
+    ring->tail = 0;
+
+  *count = chunk;
+  return chunk ? position : NULL;
+}
+/*----------------------------------------------------------------------------*/
+void pcmRingRelease(struct PcmRing *ring, size_t length)
+{
+  assert(length <= ring->used);
+
+  ring->release += length;
+  ring->used -= length;
+
+  if (ring->release == ring->size)
+    ring->release = 0;
+}
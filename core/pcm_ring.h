@@ -0,0 +1,68 @@
+/*
+ * core/pcm_ring.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_PCM_RING_H_
+#define CORE_PCM_RING_H_
+/*----------------------------------------------------------------------------*/
+#include <xcore/helpers.h>
+#include <stdbool.h>
+#include <stddef.h>
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+/*
+ * Ring of decoded PCM data. Data between release and tail positions is owned
+ * by the DMA, data between tail and head positions is ready for playback.
+ * Producer functions are called from a task, consumer functions are called
+ * from an interrupt or from a task with interrupts disabled. Chunks that do
+ * not fit before the end of the buffer are split, so the consumer receives
+ * full chunks when the size of the ring is a multiple of the chunk length.
+ */
+struct PcmRing
+{
+  uint8_t *buffer;
+  size_t size;
+
+  /* Producer position */
+  size_t head;
+  /* Position of the first byte that is not handed over to the consumer */
+  size_t tail;
+  /* Position of the first byte that is still used by the consumer */
+  size_t release;
+
+  /* Bytes ready to be handed over to the consumer */
+  size_t ready;
+  /* Bytes between release and head positions */
+  size_t used;
+
+  /* Reserved chunk is placed at the beginning of the buffer */
+  bool split;
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+void pcmRingInit(struct PcmRing *, void *, size_t);
+void pcmRingReset(struct PcmRing *);
+
+void pcmRingCommit(struct PcmRing *, size_t);
+void pcmRingDrop(struct PcmRing *);
+void *pcmRingReserve(struct PcmRing *, size_t);
+
+void *pcmRingAcquire(struct PcmRing *, size_t, size_t *);
+void pcmRingRelease(struct PcmRing *, size_t);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+static inline size_t pcmRingReady(const struct PcmRing *ring)
+{
+  return ring->ready;
+}
+/*----------------------------------------------------------------------------*/
+static inline size_t pcmRingUsed(const struct PcmRing *ring)
+{
+  return ring->used;
+}
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_PCM_RING_H_ */
@@ -5,59 +5,317 @@
  */
 
 #ifdef CONFIG_ENABLE_MP3
+#  include "mp3_defs.h"
 #  include "mp3common.h"
 #  include "mp3dec.h"
 #endif
 
+#ifdef CONFIG_ENABLE_FLAC
+#  include "flac.h"
+#endif
+
+#ifdef CONFIG_ENABLE_AAC
+#  include "aaccommon.h"
+#  include "aacdec.h"
+#  include "mp4_defs.h"
+#endif
+
+#ifdef CONFIG_ENABLE_OPUS
+#  include "ogg.h"
+#  include "opus.h"
+#endif
+
+#include "pcm_convert.h"
 #include "player.h"
+#include "trace.h"
+#include <halm/irq.h>
+#include <halm/timer.h>
 #include <halm/wq.h>
 #include <xcore/fs/utils.h>
 #include <xcore/memory.h>
 /*----------------------------------------------------------------------------*/
+#define ID3_HEADER_LENGTH 10
 #define MAX_READ_RETRIES  4
-#define MIN_BUFFER_LEVEL  64
+#define SECTOR_SIZE       512
+
+/* Next track is opened when less input is left in the current one */
+#define UPCOMING_MARGIN   65536
+
+/* Stream buffer contains a guard area for incomplete frames and a data area */
+#define STREAM_GUARD_LENGTH 2048
+#define STREAM_DATA_LENGTH  2048
+/* Input required to parse frame headers and MP3 side information */
+#define STREAM_HEADER_LENGTH 64
 
-enum TrackType
+/* Guard area should hold the longest MP3 or ADTS frame */
+static_assert(STREAM_GUARD_LENGTH + STREAM_DATA_LENGTH
+    == sizeof(((struct Player *)NULL)->buffer),
+    "Stream buffer areas do not match the file buffer");
+
+#ifndef CONFIG_DECODE_AHEAD
+#  define DECODE_AHEAD_TIME 120
+#else
+#  define DECODE_AHEAD_TIME CONFIG_DECODE_AHEAD
+#endif
+
+#ifdef CONFIG_ENABLE_OPUS
+/* Output sample rate of the decoder */
+#  define OPUS_RATE           48000
+/* Longest supported frame duration is 20 ms */
+#  define OPUS_FRAME_LENGTH   960
+/* Packets of 20 ms are limited to 1275 bytes by the specification */
+#  define OPUS_PACKET_LENGTH  1280
+
+static_assert(DECODE_CHUNK_LENGTH >= OPUS_FRAME_LENGTH * PCM_FRAME_SIZE,
+    "Decoded chunk should hold the longest supported Opus frame");
+#endif
+
+struct TrackDecoder
 {
-  TRACK_UNKNOWN,
-  TRACK_WAV,
-  TRACK_MP3
+  /* File name extensions used as a hint for probing, unused ones are NULL */
+  const char *extensions[2];
+
+  /* Parses stream headers, a probe may select a specialized decoder */
+  bool (*probe)(struct Player *, struct FsNode *, struct TrackInfo *);
+  /* Prepares the decoder for a new track or a restart after a stop, optional */
+  void (*open)(struct Player *, const struct TrackInfo *);
+  bool (*fetch)(struct Player *, uint8_t *, size_t, size_t *);
+  bool (*seek)(struct Player *, uint32_t);
+};
+
+#ifdef CONFIG_ENABLE_AAC
+/* Sampling frequencies of ADTS headers and audio specific configurations */
+static const uint32_t aacRateTable[] = {
+    96000, 88200, 64000, 48000, 44100, 32000, 24000,
+    22050, 16000, 12000, 11025, 8000, 7350
 };
+#endif
 /*----------------------------------------------------------------------------*/
 static void onAudioDataReceived(void *, struct StreamRequest *,
     enum StreamRequestStatus);
 static void onAudioDataSent(void *, struct StreamRequest *,
     enum StreamRequestStatus);
 
+static void dispatchAudioData(struct Player *);
+static void closeTrack(struct Player *);
+static void closeUpcomingTrack(struct Player *);
+static bool fetchNextChunkADPCM(struct Player *, uint8_t *, size_t, size_t *);
 static bool fetchNextChunkWAV(struct Player *, uint8_t *, size_t, size_t *);
+static const struct TrackDecoder *findDecoder(const char *);
+static struct FsNode *findTrack(struct Player *, size_t *, int,
+    struct TrackInfo *, bool *);
+static inline uint32_t getTimestamp(const struct Player *);
+static uint32_t hashTrackPath(const char *);
 static bool isDataAvailable(struct FsNode *);
 static bool isFileSupported(const char *);
 static bool isReservedName(const char *);
-static void mockControlCallback(void *, uint32_t, uint8_t);
+static bool isTrackFinished(const struct Player *);
+static struct FatLocation *locateTrack(struct Player *, size_t,
+    struct FatLocation *);
+static void locateTracks(struct Player *);
+static void mapTrackExtents(struct Player *, struct FsNode *, size_t,
+    struct TrackInfo *);
+static void mockControlCallback(void *, const struct PcmFormat *);
 static void mockStateCallback(void *, enum PlayerState);
 static struct FsNode *openTrack(struct Player *, size_t, struct TrackInfo *);
+static bool openUpcomingTrack(struct Player *);
 static void playTrack(struct Player *, size_t, int);
 static bool parseHeaderWAV(struct Player *, struct FsNode *,
     struct TrackInfo *);
+static void prepareDecoderADPCM(struct Player *, const struct TrackInfo *);
+static bool readPlaybackData(struct Player *, FsLength, void *, size_t,
+    size_t *);
+static bool readTrackData(struct Player *, struct FsNode *, FsLength,
+    size_t *);
+static void requestChunkDecoding(struct Player *);
+static void requestUpcomingTrack(struct Player *);
+static void resetLocations(struct Player *);
 static void resetPlayback(struct Player *, struct FsNode *, size_t,
     const struct TrackInfo *);
+static void resetStats(struct Player *);
 static void scanNodeDescendants(struct Player *, struct FsNode *,
     const char *, unsigned int);
+static bool seekADPCM(struct Player *, uint32_t);
+static bool seekWAV(struct Player *, uint32_t);
+static bool setupFormatWAV(const struct WavFormatExtensible *, FsLength,
+    FsLength, struct TrackInfo *);
 static void shuffleTracks(PathArray *, int (*)(void));
 static void sortTracks(PathArray *);
+static void switchToUpcomingTrack(struct Player *);
 static int trackCompare(const void *, const void *);
 
+#ifdef CONFIG_ENABLE_METADATA
+static void updateMetadata(struct Player *, struct FsNode *, size_t,
+    const struct TrackInfo *);
+#endif
+
 #ifdef CONFIG_ENABLE_MP3
 static bool fetchNextChunkMP3(struct Player *, uint8_t *, size_t, size_t *);
 static bool parseHeaderMP3(struct Player *, struct FsNode *,
     struct TrackInfo *);
+static size_t getFrameLengthMP3(const uint8_t *, const MP3FrameInfo *);
+static bool isFrameSequenceMP3(const uint8_t *, size_t, const MP3FrameInfo *);
+static bool parseFrameHeaderMP3(const uint8_t *, size_t, MP3FrameInfo *);
+static size_t parseXingHeaderMP3(const uint8_t *, size_t,
+    const MP3FrameInfo *, struct TrackInfo *);
+static void prepareDecoderMP3(struct Player *, const struct TrackInfo *);
+static void resetDecoderMP3(struct Player *);
+static bool seekMP3(struct Player *, uint32_t);
+#endif
+
+#ifdef CONFIG_ENABLE_FLAC
+static bool fetchNextChunkFLAC(struct Player *, uint8_t *, size_t, size_t *);
+static bool parseHeaderFLAC(struct Player *, struct FsNode *,
+    struct TrackInfo *);
+static void prepareDecoderFLAC(struct Player *, const struct TrackInfo *);
+static bool seekFLAC(struct Player *, uint32_t);
+#endif
+
+#ifdef CONFIG_ENABLE_AAC
+static bool bufferSampleM4A(struct Player *, FsLength, uint32_t);
+static int decodeFrameAAC(struct Player *, unsigned char **, int *,
+    uint8_t *, size_t *);
+static bool fetchNextChunkAAC(struct Player *, uint8_t *, size_t, size_t *);
+static bool fetchNextChunkM4A(struct Player *, uint8_t *, size_t, size_t *);
+static bool findBoxM4A(struct FsNode *, FsLength, FsLength, uint32_t,
+    FsLength *, FsLength *);
+static size_t getFrameLengthAAC(const uint8_t *, size_t);
+static inline uint32_t getWordM4A(const uint8_t *);
+static bool loadEntryM4A(struct Player *, uint32_t, uint32_t *);
+static bool locateSampleM4A(struct Player *, uint32_t);
+static bool nextSampleM4A(struct Player *, FsLength *, uint32_t *);
+static bool parseConfigM4A(const uint8_t *, size_t, struct TrackInfo *);
+static bool parseHeaderAAC(struct Player *, struct FsNode *,
+    struct TrackInfo *);
+static bool parseHeaderM4A(struct Player *, struct FsNode *,
+    struct TrackInfo *);
+static bool parseTrackM4A(struct Player *, struct FsNode *, FsLength,
+    FsLength, struct TrackInfo *);
+static void prepareDecoderAAC(struct Player *, const struct TrackInfo *);
+static bool readChunkOffsetM4A(struct Player *, uint32_t, FsLength *);
+static bool readDescriptorM4A(const uint8_t **, const uint8_t *, uint8_t,
+    size_t *);
+static bool readFileM4A(struct FsNode *, FsLength, void *, size_t);
+static bool readSampleSizeM4A(struct Player *, uint32_t, uint32_t *);
+static bool seekAAC(struct Player *, uint32_t);
+static bool seekM4A(struct Player *, uint32_t);
+#endif
+
+#ifdef CONFIG_ENABLE_OPUS
+static bool fetchNextChunkOPUS(struct Player *, uint8_t *, size_t, size_t *);
+static bool findGranuleOPUS(struct Player *, struct FsNode *, FsLength,
+    FsLength, uint32_t, uint64_t *);
+static bool parseHeaderOPUS(struct Player *, struct FsNode *,
+    struct TrackInfo *);
+static void prepareDecoderOPUS(struct Player *, const struct TrackInfo *);
+static bool seekOPUS(struct Player *, uint32_t);
+#endif
+
+#if defined(CONFIG_ENABLE_AAC) || defined(CONFIG_ENABLE_MP3)
+static bool fillStreamBuffer(struct Player *, bool);
+static FsLength getTagLengthID3(const uint8_t *, size_t);
+#endif
+
+#if defined(CONFIG_ENABLE_FLAC) || defined(CONFIG_ENABLE_OPUS)
+static bool readStreamChunk(void *, const uint8_t **, size_t *);
+#endif
+
+#if defined(CONFIG_ENABLE_MP3) || defined(CONFIG_ENABLE_OPUS)
+static size_t trimSamples(struct TrackInfo *, uint8_t *, size_t, size_t);
 #endif
 
 static void abortPlayingTask(void *);
 static void fetchNextChunkTask(void *);
-static inline void playNextTask(void *);
+static void openUpcomingTask(void *);
+static void playNextTask(void *);
 static void stopPlayingTask(void *);
 /*----------------------------------------------------------------------------*/
+static const struct TrackDecoder decoderADPCM = {
+    .extensions = {".wav", NULL},
+    .probe = parseHeaderWAV,
+    .open = prepareDecoderADPCM,
+    .fetch = fetchNextChunkADPCM,
+    .seek = seekADPCM
+};
+
+static const struct TrackDecoder decoderWAV = {
+    .extensions = {".wav", NULL},
+    .probe = parseHeaderWAV,
+    .open = NULL,
+    .fetch = fetchNextChunkWAV,
+    .seek = seekWAV
+};
+
+#ifdef CONFIG_ENABLE_MP3
+static const struct TrackDecoder decoderMP3 = {
+    .extensions = {".mp3", NULL},
+    .probe = parseHeaderMP3,
+    .open = prepareDecoderMP3,
+    .fetch = fetchNextChunkMP3,
+    .seek = seekMP3
+};
+#endif
+
+#ifdef CONFIG_ENABLE_FLAC
+static const struct TrackDecoder decoderFLAC = {
+    .extensions = {".flac", NULL},
+    .probe = parseHeaderFLAC,
+    .open = prepareDecoderFLAC,
+    .fetch = fetchNextChunkFLAC,
+    .seek = seekFLAC
+};
+#endif
+
+#ifdef CONFIG_ENABLE_AAC
+static const struct TrackDecoder decoderAAC = {
+    .extensions = {".aac", NULL},
+    .probe = parseHeaderAAC,
+    .open = prepareDecoderAAC,
+    .fetch = fetchNextChunkAAC,
+    .seek = seekAAC
+};
+
+static const struct TrackDecoder decoderM4A = {
+    .extensions = {".m4a", NULL},
+    .probe = parseHeaderM4A,
+    .open = prepareDecoderAAC,
+    .fetch = fetchNextChunkM4A,
+    .seek = seekM4A
+};
+#endif
+
+#ifdef CONFIG_ENABLE_OPUS
+static const struct TrackDecoder decoderOPUS = {
+    .extensions = {".opus", ".ogg"},
+    .probe = parseHeaderOPUS,
+    .open = prepareDecoderOPUS,
+    .fetch = fetchNextChunkOPUS,
+    .seek = seekOPUS
+};
+#endif
+
+/*
+ * Decoders are probed in this order when the file name gives no hint.
+ * Streams with strict headers go first, MP3 probing scans the file for
+ * frame synchronization and should be the last one.
+ */
+static const struct TrackDecoder * const decoders[] = {
+    &decoderWAV,
+#ifdef CONFIG_ENABLE_FLAC
+    &decoderFLAC,
+#endif
+#ifdef CONFIG_ENABLE_OPUS
+    &decoderOPUS,
+#endif
+#ifdef CONFIG_ENABLE_AAC
+    &decoderM4A,
+    &decoderAAC,
+#endif
+#ifdef CONFIG_ENABLE_MP3
+    &decoderMP3
+#endif
+};
+/*----------------------------------------------------------------------------*/
 static void onAudioDataReceived(void *argument, struct StreamRequest *request,
     enum StreamRequestStatus status)
 {
@@ -72,117 +330,222 @@ static void onAudioDataSent(void *argument, struct StreamRequest *request,
 {
   struct Player * const player = argument;
 
+  pcmRingRelease(&player->pcm.ring, request->length);
   request->length = 0;
 
+  /* Requests are completed in the order they will be enqueued again */
+  pointerQueuePushBack(&player->txQueue, request);
+
   if (status != STREAM_REQUEST_COMPLETED || player->playback.stop)
   {
     wqAdd(WQ_DEFAULT, stopPlayingTask, player);
   }
   else if (player->playback.playing)
   {
-    wqAdd(WQ_DEFAULT, fetchNextChunkTask, player);
+    dispatchAudioData(player);
+
+    if (pointerQueueSize(&player->txQueue) == player->buffers
+        && !player->playback.eof && !player->stats.starving)
+    {
+      /* Transmit stream has no queued requests, playback is interrupted */
+      player->stats.starving = true;
+      player->stats.timestamp = getTimestamp(player);
+      ++player->stats.underruns;
+    }
+
+    if (!player->playback.eof
+        && pcmRingUsed(&player->pcm.ring) < player->pcm.low)
+    {
+      requestChunkDecoding(player);
+    }
   }
 }
 /*----------------------------------------------------------------------------*/
-#ifdef CONFIG_ENABLE_MP3
-static bool fetchNextChunkMP3(struct Player *player, uint8_t *buffer,
-    size_t capacity, size_t *count)
+static void dispatchAudioData(struct Player *player)
 {
-  struct TrackInfo * const info = &player->playback.info;
-  size_t processed = 0;
+  struct PcmRing * const ring = &player->pcm.ring;
 
-  while (processed < capacity)
+  while (!pointerQueueEmpty(&player->txQueue))
   {
-    enum Result res = E_OK;
+    struct StreamRequest * const request = pointerQueueFront(&player->txQueue);
 
-    if (!player->bufferSize)
+    /* Only the tail of the track may be sent in a partially filled request */
+    if (!player->playback.eof && pcmRingReady(ring) < request->capacity)
+      break;
+
+    size_t count;
+    void * const buffer = pcmRingAcquire(ring, request->capacity, &count);
+
+    if (buffer == NULL)
+      break;
+
+    pointerQueuePopFront(&player->txQueue);
+
+    request->buffer = buffer;
+    request->length = count;
+    streamEnqueue(player->tx, request);
+
+    player->stats.shortfall += (uint32_t)(request->capacity - count);
+    ++player->stats.requests;
+
+    if (player->stats.starving)
     {
-      /* Initial buffer filling */
+      const uint32_t gap = getTimestamp(player) - player->stats.timestamp;
+
+      player->stats.gap = MAX(player->stats.gap, gap);
+      player->stats.starving = false;
+    }
+  }
+
+  if (player->playback.eof && !player->playback.next
+      && !pcmRingReady(ring))
+  {
+    player->playback.next = true;
+    wqAdd(WQ_DEFAULT, playNextTask, player);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void closeTrack(struct Player *player)
+{
+  [[maybe_unused]] const struct PlayerStats stats = playerGetStats(player);
+
+  debugTrace("Player track %lu underruns %lu gap %lu refill %lu load %lu"
+      " peak %lu fill %lu read %lu.%03lu MB/s",
+      (unsigned long)(player->playback.index + 1),
+      (unsigned long)stats.underruns,
+      (unsigned long)stats.gap,
+      (unsigned long)stats.refill,
+      (unsigned long)stats.load,
+      (unsigned long)stats.peak,
+      (unsigned long)stats.fill,
+      (unsigned long)(stats.throughput / 1000),
+      (unsigned long)(stats.throughput % 1000)
+  );
 
-      const FsLength offset = info->position % sizeof(player->buffer);
-      size_t chunk = sizeof(player->buffer);
+  fsNodeFree(player->playback.file);
+  player->playback.file = NULL;
+}
+/*----------------------------------------------------------------------------*/
+static void closeUpcomingTrack(struct Player *player)
+{
+  if (player->upcoming.file != NULL)
+  {
+    fsNodeFree(player->upcoming.file);
+    player->upcoming.file = NULL;
+  }
 
-      /* Align the size of file read requests along file system sector size */
-      if (offset != 0)
-        chunk -= (size_t)offset;
+  player->upcoming.checked = false;
+}
+/*----------------------------------------------------------------------------*/
+static bool fetchNextChunkADPCM(struct Player *player, uint8_t *buffer,
+    size_t capacity, size_t *count)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  struct AdpcmDecoder * const decoder = &player->adpcm;
+  const size_t header = ADPCM_HEADER_LENGTH * info->channels;
+  const size_t group = ADPCM_GROUP_LENGTH * info->channels;
+  const size_t frames = capacity / PCM_FRAME_SIZE;
+  size_t processed = 0;
 
-      for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
+  while (processed < frames)
+  {
+    const size_t required = decoder->groups ? group : header;
+    size_t left = player->bufferSize - player->bufferPosition;
+
+    if (left < required)
+    {
+      if (info->position >= info->end)
       {
-        res = fsNodeRead(
-            player->playback.file,
-            FS_NODE_DATA,
-            info->position,
-            player->buffer.raw,
-            chunk,
-            &player->bufferSize
-        );
+        /* Incomplete group at the end of the file */
+        player->bufferPosition = player->bufferSize;
+        break;
+      }
 
-        if (res == E_OK)
-          break;
+      if (left)
+      {
+        memmove(player->buffer.raw,
+            player->buffer.raw + player->bufferPosition, left);
       }
 
-      if (res == E_OK)
+      /* Align the end of file read requests along file system sector size */
+      const FsLength available = info->end - info->position;
+      size_t chunk = sizeof(player->buffer) - left;
+      size_t read;
+
+      chunk -= (size_t)((info->position + chunk) % SECTOR_SIZE);
+      if (available < chunk)
+        chunk = (size_t)available;
+
+      if (!readPlaybackData(player, info->position, player->buffer.raw + left,
+          chunk, &read) || read != chunk)
       {
-        player->bufferPosition = 0;
-        info->position += (FsLength)player->bufferSize;
+        return false;
       }
+
+      player->bufferPosition = 0;
+      player->bufferSize = left + read;
+      info->position += (FsLength)read;
+      continue;
     }
 
-    size_t left = player->bufferSize - player->bufferPosition;
+    const uint8_t * const input = player->buffer.raw + player->bufferPosition;
+    uint8_t * const output = buffer + processed * PCM_FRAME_SIZE;
 
-    if (info->position < info->end && left <= sizeof(player->buffer) / 2)
+    if (!decoder->groups)
     {
-      /* Half of the buffer is available */
+      /* Block header contains the first sample of the block */
+      if (!adpcmDecodeHeader(decoder, output, input))
+        return false;
 
-      size_t alignment = left & (sizeof(void *) - 1);
-      size_t read;
+      decoder->groups = (info->block - header) / group;
+      player->bufferPosition += header;
+      ++processed;
+    }
+    else
+    {
+      const size_t groups = MIN(MIN(decoder->groups, left / group),
+          (frames - processed) / ADPCM_GROUP_SAMPLES);
 
-      if (alignment)
-        alignment = sizeof(void *) - alignment;
-      if (alignment > player->bufferPosition)
-        alignment = 0;
+      if (!groups)
+        break;
 
-      player->bufferPosition -= alignment;
-      left += alignment;
+      adpcmDecodeGroups(decoder, output, input, groups);
 
-      if (player->bufferPosition > 0)
-      {
-        assert((left & (sizeof(void *) - 1)) == 0);
+      decoder->groups -= groups;
+      player->bufferPosition += groups * group;
+      processed += groups * ADPCM_GROUP_SAMPLES;
+    }
+  }
 
-        memmove(player->buffer.raw, player->buffer.raw + player->bufferPosition,
-            left);
-      }
+  info->sample += (uint32_t)processed;
 
-      for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
-      {
-        res = fsNodeRead(
-            player->playback.file,
-            FS_NODE_DATA,
-            info->position,
-            player->buffer.raw + left,
-            sizeof(player->buffer) / 2,
-            &read
-        );
+  *count = processed * PCM_FRAME_SIZE;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_AAC
+static bool fetchNextChunkAAC(struct Player *player, uint8_t *buffer,
+    size_t capacity, size_t *count)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  size_t processed = 0;
 
-        if (res == E_OK)
-          break;
-      }
+  if (player->aacDecoder == NULL)
+    return false;
 
-      if (res == E_OK)
-      {
-        player->bufferPosition = alignment;
-        player->bufferSize = left + read;
-        info->position += (FsLength)read;
-      }
-    }
+  bool underflow = false;
 
-    if (res != E_OK)
+  /* Decoder has no output limit, the whole frame should fit in the buffer */
+  while (capacity - processed >= AAC_MAX_NSAMPS * PCM_FRAME_SIZE)
+  {
+    if (!fillStreamBuffer(player, underflow))
       return false;
+    underflow = false;
 
     if (player->bufferPosition >= player->bufferSize)
       break;
 
-    const int offset = MP3FindSyncWord(
+    const int offset = AACFindSyncWord(
         player->buffer.raw + player->bufferPosition,
         player->bufferSize - player->bufferPosition
     );
@@ -194,37 +557,39 @@ static bool fetchNextChunkMP3(struct Player *player, uint8_t *buffer,
       unsigned char *inputBuffer = player->buffer.raw + player->bufferPosition;
       const int inputBufferSize = player->bufferSize - player->bufferPosition;
       int inputBytesLeft = inputBufferSize;
+      size_t decoded;
 
-      const int error = MP3Decode(
-          player->mp3Decoder,
-          &inputBuffer,
-          &inputBytesLeft,
-          (short *)(buffer + processed),
-          (capacity - processed) / sizeof(short),
-          0 /* Normal MPEG format */
-      );
-
-      if (error == ERR_MP3_NONE)
+      if (getFrameLengthAAC(inputBuffer, (size_t)inputBufferSize)
+          > (size_t)inputBufferSize && info->position < info->end)
       {
-        MP3FrameInfo frameInfo;
+        /* Rest of the frame is read on the next pass */
+        underflow = true;
+        continue;
+      }
 
-        MP3GetLastFrameInfo(player->mp3Decoder, &frameInfo);
-        processed += (size_t)frameInfo.outputSamps * sizeof(short);
+      const int error = decodeFrameAAC(player, &inputBuffer, &inputBytesLeft,
+          buffer + processed, &decoded);
+
+      processed += decoded;
+
+      if (error == ERR_AAC_INDATA_UNDERFLOW && info->position >= info->end)
+      {
+        /* Incomplete frame at the end of the file */
+        player->bufferPosition = player->bufferSize;
       }
-      else if (error == ERR_MP3_OUT_OF_MEMORY)
+      else if (inputBytesLeft != inputBufferSize)
       {
-        /* Output buffer is full */
-        break;
+        player->bufferPosition += (size_t)(inputBufferSize - inputBytesLeft);
       }
-
-      if (error == ERR_MP3_INVALID_FRAMEHEADER)
+      else if (error == ERR_AAC_INDATA_UNDERFLOW)
       {
-        /* Try from a next byte */
-        ++player->bufferPosition;
+        /* Rest of the frame is read on the next pass */
+        underflow = true;
       }
       else
       {
-        player->bufferPosition += (size_t)(inputBufferSize - inputBytesLeft);
+        /* Try from a next byte */
+        ++player->bufferPosition;
       }
     }
     else
@@ -237,264 +602,2507 @@ static bool fetchNextChunkMP3(struct Player *player, uint8_t *buffer,
   *count = processed;
   return true;
 }
-#endif
 /*----------------------------------------------------------------------------*/
-static bool fetchNextChunkWAV(struct Player *player, uint8_t *buffer,
+static bool fetchNextChunkM4A(struct Player *player, uint8_t *buffer,
     size_t capacity, size_t *count)
 {
   struct TrackInfo * const info = &player->playback.info;
-  size_t chunk = capacity;
-  const FsLength left = info->end - info->position;
-  const FsLength offset = info->position % chunk;
-  enum Result res;
-
-  /* Align the size of file read requests along file system sector size */
-  if (offset != 0)
-    chunk -= (size_t)offset;
+  struct Mp4Cursor * const cursor = &player->mp4;
+  size_t processed = 0;
 
-  if (left < chunk)
-    chunk = (size_t)left;
+  if (player->aacDecoder == NULL)
+    return false;
+  if (!cursor->chunk && !locateSampleM4A(player, 0))
+    return false;
 
-  for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
+  /* Decoder has no output limit, the whole frame should fit in the buffer */
+  while (capacity - processed >= AAC_MAX_NSAMPS * PCM_FRAME_SIZE)
   {
-    res = fsNodeRead(
-        player->playback.file,
-        FS_NODE_DATA,
-        info->position,
-        buffer,
-        chunk,
-        count
-    );
-
-    if (res == E_OK)
+    if (cursor->sample >= info->tables.samples)
+    {
+      /* Buffered input is not needed anymore */
+      player->bufferPosition = player->bufferSize;
+      info->position = info->end;
       break;
-  }
+    }
 
-  if (res == E_OK && *count == chunk)
-  {
-    info->position += (FsLength)(*count);
-    return true;
+    FsLength position;
+    uint32_t size;
+
+    if (!nextSampleM4A(player, &position, &size))
+      return false;
+
+    /* Raw data blocks of AAC-LC streams are much shorter than the buffer */
+    if (!size || size > sizeof(player->buffer) - SECTOR_SIZE)
+      continue;
+    if (!bufferSampleM4A(player, position, size))
+      return false;
+
+    unsigned char *inputBuffer = player->buffer.raw
+        + (size_t)(position - cursor->base);
+    int inputBytesLeft = (int)size;
+    size_t decoded;
+
+    decodeFrameAAC(player, &inputBuffer, &inputBytesLeft,
+        buffer + processed, &decoded);
+    processed += decoded;
+
+    /* Sample counter is restored when a frame is skipped */
+    info->sample = cursor->sample * AAC_MAX_NSAMPS;
   }
-  else
-    return false;
-}
-/*----------------------------------------------------------------------------*/
-static bool isDataAvailable(struct FsNode *node)
-{
-  return fsNodeRead(node, FS_NODE_DATA, 0, NULL, 0, NULL) == E_OK;
+
+  *count = processed;
+  return true;
 }
+#endif
 /*----------------------------------------------------------------------------*/
-static bool isFileSupported(const char *name)
+#ifdef CONFIG_ENABLE_FLAC
+static bool fetchNextChunkFLAC(struct Player *player, uint8_t *buffer,
+    size_t capacity, size_t *count)
 {
-  bool match = false;
+  struct TrackInfo * const info = &player->playback.info;
+  const uint64_t decoded = flacDecoderGetDecoded(player->flacDecoder);
+  const uint32_t reading = player->stats.reading;
+  const uint32_t timestamp = getTimestamp(player);
 
-  if (strstr(name, ".wav"))
-  {
-    match = true;
-  }
-#ifdef CONFIG_ENABLE_MP3
-  else if (strstr(name, ".mp3"))
+  const enum FlacStatus status = flacDecoderRead(player->flacDecoder, buffer,
+      capacity, count);
+
+  if (status == FLAC_ERROR)
+    return false;
+
+  const uint32_t frames = (uint32_t)(flacDecoderGetDecoded(player->flacDecoder)
+      - decoded);
+
+  if (frames)
   {
-    match = true;
+    /* Time spent reading the input is not included in the decoding time */
+    const uint32_t ticks = getTimestamp(player) - timestamp
+        - (player->stats.reading - reading);
+
+    /* Block with the least real-time headroom is kept */
+    if (!player->stats.peakFrames || (uint64_t)ticks * player->stats.peakFrames
+        > (uint64_t)player->stats.peak * frames)
+    {
+      player->stats.peak = ticks;
+      player->stats.peakFrames = frames;
+    }
   }
-#endif
-  else
+
+  info->sample = (uint32_t)flacDecoderGetSample(player->flacDecoder);
+
+  if (status == FLAC_END)
   {
-    match = false;
+    /* Buffered input is not needed anymore */
+    player->bufferPosition = player->bufferSize;
+    info->position = info->end;
   }
 
-  return match;
-}
-/*----------------------------------------------------------------------------*/
-static bool isReservedName(const char *name)
-{
-  return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
-}
-/*----------------------------------------------------------------------------*/
-static void mockControlCallback(void *, uint32_t, uint8_t)
-{
+  return true;
 }
+#endif
 /*----------------------------------------------------------------------------*/
-static void mockStateCallback(void *, enum PlayerState)
+#ifdef CONFIG_ENABLE_MP3
+static bool fetchNextChunkMP3(struct Player *player, uint8_t *buffer,
+    size_t capacity, size_t *count)
 {
-}
-/*----------------------------------------------------------------------------*/
+  struct TrackInfo * const info = &player->playback.info;
+  size_t processed = 0;
+  bool underflow = false;
+
+  if (player->mp3Decoder == NULL)
+    return false;
+
+  while (processed < capacity)
+  {
+    if (!fillStreamBuffer(player, underflow))
+      return false;
+    underflow = false;
+
+    if (player->bufferPosition >= player->bufferSize)
+      break;
+
+    const int offset = MP3FindSyncWord(
+        player->buffer.raw + player->bufferPosition,
+        player->bufferSize - player->bufferPosition
+    );
+
+    if (offset >= 0)
+    {
+      player->bufferPosition += (size_t)offset;
+
+      unsigned char *inputBuffer = player->buffer.raw + player->bufferPosition;
+      const int inputBufferSize = player->bufferSize - player->bufferPosition;
+      int inputBytesLeft = inputBufferSize;
+
+      /* Mono frames are expanded to stereo after decoding */
+      const int error = MP3Decode(
+          player->mp3Decoder,
+          &inputBuffer,
+          &inputBytesLeft,
+          (short *)(buffer + processed),
+          (capacity - processed) / PCM_FRAME_SIZE * info->channels,
+          0 /* Normal MPEG format */
+      );
+
+      if (error == ERR_MP3_NONE)
+      {
+        MP3FrameInfo frameInfo;
+
+        MP3GetLastFrameInfo(player->mp3Decoder, &frameInfo);
+
+        const size_t channels = (size_t)frameInfo.nChans;
+        const size_t samples = trimSamples(info, buffer + processed,
+            (size_t)frameInfo.outputSamps / channels, channels);
+
+        processed += pcmConvert(buffer + processed,
+            samples * channels * sizeof(short), sizeof(short), channels);
+      }
+      else if (error == ERR_MP3_OUT_OF_MEMORY)
+      {
+        /* Output buffer is full */
+        break;
+      }
+
+      if (error == ERR_MP3_INVALID_FRAMEHEADER)
+      {
+        /* Try from a next byte */
+        ++player->bufferPosition;
+      }
+      else if (error == ERR_MP3_INDATA_UNDERFLOW)
+      {
+        if (info->position >= info->end)
+        {
+          /* Incomplete frame at the end of the file */
+          player->bufferPosition = player->bufferSize;
+        }
+        else
+        {
+          /* Rest of the frame is read on the next pass */
+          underflow = true;
+        }
+      }
+      else
+      {
+        player->bufferPosition += (size_t)(inputBufferSize - inputBytesLeft);
+      }
+
+      if (info->length && info->sample >= info->delay + info->length)
+      {
+        /* Encoder padding at the end of the stream is not played */
+        player->bufferPosition = player->bufferSize;
+        info->position = info->end;
+        break;
+      }
+    }
+    else
+    {
+      /* Discard all buffered data and read a next chunk */
+      player->bufferPosition = player->bufferSize;
+    }
+  }
+
+  *count = processed;
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_OPUS
+static bool fetchNextChunkOPUS(struct Player *player, uint8_t *buffer,
+    size_t capacity, size_t *count)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const size_t channels = info->channels;
+  size_t processed = 0;
+
+  /* Packets are read only when the longest supported frame fits */
+  while ((capacity - processed) / PCM_FRAME_SIZE >= OPUS_FRAME_LENGTH)
+  {
+    const uint8_t *packet;
+    size_t length;
+    const enum OggStatus status = oggReaderRead(player->oggReader, &packet,
+        &length);
+
+    if (status == OGG_ERROR)
+      return false;
+
+    if (status == OGG_END)
+    {
+      /* Buffered input is not needed anymore */
+      player->bufferPosition = player->bufferSize;
+      info->position = info->end;
+      break;
+    }
+
+    /* Empty packets are not decoded to avoid packet loss concealment */
+    if (!length)
+      continue;
+
+    /* Longer packets and corrupted packets are dropped */
+    const int samples = opus_decode(
+        player->opusDecoder,
+        packet,
+        (opus_int32)length,
+        (opus_int16 *)(buffer + processed),
+        OPUS_FRAME_LENGTH,
+        0
+    );
+
+    if (samples > 0)
+    {
+      const size_t trimmed = trimSamples(info, buffer + processed,
+          (size_t)samples, channels);
+
+      processed += pcmConvert(buffer + processed,
+          trimmed * channels * sizeof(short), sizeof(short), channels);
+    }
+
+    if (info->length && info->sample >= info->delay + info->length)
+    {
+      /* Samples after the end position of the stream are not played */
+      player->bufferPosition = player->bufferSize;
+      info->position = info->end;
+      break;
+    }
+  }
+
+  *count = processed;
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+static bool fetchNextChunkWAV(struct Player *player, uint8_t *buffer,
+    size_t capacity, size_t *count)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const size_t frame = info->channels * info->width;
+  /* Both source data and converted frames should fit in the buffer */
+  size_t length = MIN(capacity / PCM_FRAME_SIZE * frame, capacity);
+  size_t processed = 0;
+
+  length -= length % frame;
+
+  while (processed < length)
+  {
+    size_t left = player->bufferSize - player->bufferPosition;
+
+    if (!left)
+    {
+      if (info->position >= info->end)
+        break;
+
+      const size_t offset = (size_t)(info->position % SECTOR_SIZE);
+      size_t chunk = (size_t)MIN(info->end - info->position,
+          (FsLength)(length - processed));
+      size_t read;
+
+      if (!offset && chunk >= SECTOR_SIZE)
+      {
+        /* Whole sectors are read directly into the output buffer */
+        chunk -= chunk % SECTOR_SIZE;
+
+        if (!readPlaybackData(player, info->position, buffer + processed,
+            chunk, &read) || !read)
+        {
+          return false;
+        }
+
+        info->position += (FsLength)read;
+        processed += read;
+        continue;
+      }
+
+      /* Only the sector with the unaligned head or tail is staged */
+      const FsLength base = info->position - offset;
+
+      chunk = (size_t)MIN(info->end - base, (FsLength)SECTOR_SIZE);
+
+      if (!readPlaybackData(player, base, player->buffer.raw, chunk, &read)
+          || base + read <= info->position)
+      {
+        return false;
+      }
+
+      player->bufferPosition = offset;
+      player->bufferSize = read;
+      info->position = base + read;
+      left = player->bufferSize - player->bufferPosition;
+    }
+
+    const size_t part = MIN(left, length - processed);
+
+    memcpy(buffer + processed, player->buffer.raw + player->bufferPosition,
+        part);
+    player->bufferPosition += part;
+    processed += part;
+  }
+
+  /* Incomplete frame at the end of the stream is dropped */
+  processed -= processed % frame;
+
+  info->sample += (uint32_t)(processed / frame);
+  *count = pcmConvert(buffer, processed, info->width, info->channels);
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+#if defined(CONFIG_ENABLE_AAC) || defined(CONFIG_ENABLE_MP3)
+/*
+ * File data is always read into the data area of the stream buffer. When
+ * the decoder runs out of input, an incomplete frame from the end of the
+ * buffer is copied to the end of the guard area, so frames are contiguous
+ * and complete frames are never moved.
+ */
+static bool fillStreamBuffer(struct Player *player, bool underflow)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  uint8_t * const data = player->buffer.raw + STREAM_GUARD_LENGTH;
+  size_t chunk = STREAM_DATA_LENGTH;
+  size_t left = 0;
+  size_t read;
+
+  if (!player->bufferSize)
+  {
+    /* Align file read requests along the length of the data area */
+    chunk -= (size_t)(info->position % STREAM_DATA_LENGTH);
+  }
+  else
+  {
+    left = player->bufferSize - player->bufferPosition;
+
+    if (info->position >= info->end
+        || (left >= STREAM_HEADER_LENGTH && !underflow))
+    {
+      return true;
+    }
+
+    if (left > STREAM_GUARD_LENGTH)
+    {
+      /* Frame can not be longer than the guard area, skip the broken one */
+      ++player->bufferPosition;
+      return true;
+    }
+
+    memmove(data - left, player->buffer.raw + player->bufferPosition, left);
+  }
+
+  if (!readPlaybackData(player, info->position, data, chunk, &read))
+    return false;
+
+  player->bufferPosition = STREAM_GUARD_LENGTH - left;
+  player->bufferSize = STREAM_GUARD_LENGTH + read;
+  info->position += (FsLength)read;
+
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#if defined(CONFIG_ENABLE_AAC) || defined(CONFIG_ENABLE_MP3)
+/* Returns the length of the ID3v2 tag including the footer, zero when absent */
+static FsLength getTagLengthID3(const uint8_t *data, size_t count)
+{
+  if (count < ID3_HEADER_LENGTH || memcmp(data, "ID3", 3))
+    return 0;
+
+  /* Tag size is stored in 7-bit bytes */
+  FsLength length = ID3_HEADER_LENGTH + (((FsLength)(data[6] & 0x7F) << 21)
+      | ((FsLength)(data[7] & 0x7F) << 14)
+      | ((FsLength)(data[8] & 0x7F) << 7) | (data[9] & 0x7F));
+
+  /* Footer is present */
+  if (data[5] & 0x10)
+    length += ID3_HEADER_LENGTH;
+
+  return length;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#if defined(CONFIG_ENABLE_FLAC) || defined(CONFIG_ENABLE_OPUS)
+static bool readStreamChunk(void *argument, const uint8_t **data, size_t *count)
+{
+  struct Player * const player = argument;
+  struct TrackInfo * const info = &player->playback.info;
+  const FsLength left = info->end - info->position;
+  const FsLength offset = info->position % SECTOR_SIZE;
+  size_t chunk = sizeof(player->buffer) - (size_t)offset;
+  size_t read = 0;
+
+  if (left < chunk)
+    chunk = (size_t)left;
+
+  if (chunk && !readPlaybackData(player, info->position, player->buffer.raw,
+      chunk, &read))
+  {
+    return false;
+  }
+
+  /* Buffer stays occupied until the decoder reaches the end of the stream */
+  player->bufferPosition = 0;
+  player->bufferSize = read;
+  info->position += (FsLength)read;
+
+  *data = player->buffer.raw;
+  *count = read;
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#if defined(CONFIG_ENABLE_MP3) || defined(CONFIG_ENABLE_OPUS)
+static size_t trimSamples(struct TrackInfo *info, uint8_t *buffer,
+    size_t count, size_t channels)
+{
+  const uint32_t first = info->sample;
+
+  info->sample += (uint32_t)count;
+
+  /* Most of the frames are played without changes */
+  if (first >= info->delay
+      && (!info->length || info->sample <= info->delay + info->length))
+  {
+    return count;
+  }
+
+  const size_t width = channels * sizeof(short);
+  size_t begin = 0;
+  size_t end = count;
+
+  if (first < info->delay)
+    begin = MIN(info->delay - first, count);
+
+  if (info->length)
+  {
+    const uint32_t limit = info->delay + info->length;
+    end = first < limit ? MIN(limit - first, count) : 0;
+  }
+
+  if (end <= begin)
+    return 0;
+
+  if (begin)
+    memmove(buffer, buffer + begin * width, (end - begin) * width);
+
+  return end - begin;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+static const struct TrackDecoder *findDecoder(const char *name)
+{
+  const char * const extension = strrchr(name, '.');
+
+  if (extension == NULL)
+    return NULL;
+
+  for (size_t i = 0; i < ARRAY_SIZE(decoders); ++i)
+  {
+    for (size_t j = 0; j < ARRAY_SIZE(decoders[i]->extensions); ++j)
+    {
+      const char * const entry = decoders[i]->extensions[j];
+
+      if (entry != NULL && !strcmp(extension, entry))
+        return decoders[i];
+    }
+  }
+
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+static struct FsNode *findTrack(struct Player *player, size_t *position,
+    int dir, struct TrackInfo *info, bool *error)
+{
+  const size_t count = pathArraySize(&player->tracks);
+  const size_t start = *position;
+  size_t current = start;
+
+  *error = false;
+
+  do
+  {
+    struct FsNode * const node = openTrack(player, current, info);
+
+    if (node == NULL)
+    {
+      *error = true;
+      break;
+    }
+
+    if (info->decoder != NULL)
+    {
+      mapTrackExtents(player, node, current, info);
+
+      *position = current;
+      return node;
+    }
+
+    fsNodeFree(node);
+
+    if (dir > 0)
+    {
+      /* Try to play a next track */
+      current = (current == count - 1) ? 0 : current + 1;
+    }
+    else
+    {
+      /* Try to play a previous track */
+      current = (current == 0) ? count - 1 : current - 1;
+    }
+  }
+  while (current != start);
+
+  return NULL;
+}
+/*----------------------------------------------------------------------------*/
+static inline uint32_t getTimestamp(const struct Player *player)
+{
+  return player->stats.timer != NULL ? timerGetValue(player->stats.timer) : 0;
+}
+/*----------------------------------------------------------------------------*/
+static uint32_t hashTrackPath(const char *path)
+{
+  uint32_t hash = 0x811C9DC5UL;
+
+  /* FNV-1a hash */
+  while (*path)
+  {
+    hash ^= (uint8_t)*path++;
+    hash *= 0x01000193UL;
+  }
+
+  return hash;
+}
+/*----------------------------------------------------------------------------*/
+static bool isDataAvailable(struct FsNode *node)
+{
+  return fsNodeRead(node, FS_NODE_DATA, 0, NULL, 0, NULL) == E_OK;
+}
+/*----------------------------------------------------------------------------*/
+static bool isFileSupported(const char *name)
+{
+  return findDecoder(name) != NULL;
+}
+/*----------------------------------------------------------------------------*/
+static bool isReservedName(const char *name)
+{
+  return name[0] == '.' && (!name[1] || (name[1] == '.' && !name[2]));
+}
+/*----------------------------------------------------------------------------*/
+static bool isTrackFinished(const struct Player *player)
+{
+  return player->playback.info.position >= player->playback.info.end
+      && player->bufferPosition >= player->bufferSize;
+}
+/*----------------------------------------------------------------------------*/
+static struct FatLocation *locateTrack(struct Player *player, size_t position,
+    struct FatLocation *buffer)
+{
+  struct FatLocation *location = buffer;
+
+  if (player->volume == NULL)
+    return NULL;
+
+  if (position < player->locations.count)
+  {
+    /* Entry found earlier is reused without walking the directory tree */
+    location = &player->locations.entries[position];
+    if (location->sector != 0)
+      return location;
+  }
+
+  const char * const path = pathArrayAt(&player->tracks, position)->data;
+  return fatVolumeLocate(player->volume, path, location, NULL) ?
+      location : NULL;
+}
+/*----------------------------------------------------------------------------*/
+static void locateTracks(struct Player *player)
+{
+  const size_t count = MIN(pathArraySize(&player->tracks),
+      player->locations.count);
+  struct FatCursor cursor = {0};
+  const char *previous = NULL;
+  size_t prefix = 0;
+
+  if (player->volume == NULL)
+    return;
+
+  for (size_t index = 0; index < count; ++index)
+  {
+    const char * const path = pathArrayAt(&player->tracks, index)->data;
+    const char * const separator = strrchr(path, '/');
+    const size_t length = separator != NULL ? (size_t)(separator - path) : 0;
+    struct FatLocation * const location = &player->locations.entries[index];
+
+    /* Siblings are searched from the previous entry, not from the root */
+    const bool sibling = previous != NULL && length == prefix
+        && !memcmp(path, previous, length);
+
+    if (!sibling || !fatVolumeLocateSibling(player->volume, &cursor,
+        path + length + (separator != NULL), location))
+    {
+      fatVolumeLocate(player->volume, path, location, &cursor);
+    }
+
+    previous = path;
+    prefix = length;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void mapTrackExtents(struct Player *player, struct FsNode *node,
+    size_t position, struct TrackInfo *info)
+{
+  /* Tracks opened from the directory entry are mapped already */
+  if (info->extents.count)
+    return;
+
+  struct FatLocation buffer;
+  struct FatLocation * const location = locateTrack(player, position, &buffer);
+  FsLength length;
+
+  if (location != NULL && fsNodeLength(node, FS_NODE_DATA, &length) == E_OK)
+  {
+    /* Data is read through the file system when the file is not mapped */
+    if (!fatExtentMapBuild(player->volume, location, length, &info->extents))
+      location->sector = 0;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void mockControlCallback(void *, const struct PcmFormat *)
+{
+}
+/*----------------------------------------------------------------------------*/
+static void mockStateCallback(void *, enum PlayerState)
+{
+}
+/*----------------------------------------------------------------------------*/
 static struct FsNode *openTrack(struct Player *player, size_t position,
     struct TrackInfo *info)
 {
-  assert(player->handle != NULL);
-  assert(position < pathArraySize(&player->tracks));
+  assert(player->handle != NULL);
+  assert(position < pathArraySize(&player->tracks));
+
+  const char * const path = pathArrayAt(&player->tracks, position)->data;
+  struct FsNode *node = NULL;
+
+  info->extents.count = 0;
+
+  if (player->volume != NULL && position < player->locations.count
+      && player->locations.entries[position].sector != 0)
+  {
+    const struct FatExtentNodeConfig config = {
+        .volume = player->volume,
+        .location = &player->locations.entries[position]
+    };
+    struct FatExtentNode * const direct = init(FatExtentNode, &config);
+
+    /* Entry found during the scan is opened without the path lookup */
+    if (direct != NULL)
+    {
+      info->extents = direct->map;
+      node = &direct->base;
+    }
+  }
+
+  if (node == NULL)
+    node = fsOpenNode(player->handle, path);
+
+  if (node != NULL)
+  {
+    /* Decoder selected by the file name is probed first */
+    const struct TrackDecoder * const hint = findDecoder(path);
+
+    info->decoder = hint;
+    if (hint != NULL && hint->probe(player, node, info))
+      return node;
+
+    for (size_t i = 0; i < ARRAY_SIZE(decoders); ++i)
+    {
+      if (decoders[i] == hint)
+        continue;
+
+      info->decoder = decoders[i];
+      if (decoders[i]->probe(player, node, info))
+        return node;
+    }
+
+    info->decoder = NULL;
+  }
+
+  return node;
+}
+/*----------------------------------------------------------------------------*/
+static bool openUpcomingTrack(struct Player *player)
+{
+  if (player->upcoming.file != NULL)
+    return true;
+
+  const size_t count = pathArraySize(&player->tracks);
+
+  if (player->handle == NULL || !count)
+    return false;
+
+  size_t next = player->playback.index + 1;
+  bool error;
+
+  if (next >= count)
+    next = 0;
+
+  struct FsNode * const node = findTrack(player, &next, 1,
+      &player->upcoming.info, &error);
+
+  if (node == NULL)
+    return false;
+
+  player->upcoming.file = node;
+  player->upcoming.index = next;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void playTrack(struct Player *player, size_t start, int dir)
+{
+  const size_t count = pathArraySize(&player->tracks);
+
+  if (player->handle == NULL || !count || start >= count)
+    return;
+
+  struct TrackInfo info;
+  size_t current = start;
+  bool error;
+
+  resetPlayback(player, NULL, 0, NULL);
+
+  struct FsNode * const node = findTrack(player, &current, dir, &info,
+      &error);
+
+  if (!error)
+  {
+    if (node != NULL)
+    {
+#ifdef CONFIG_ENABLE_METADATA
+      /*
+       * Tags are read before the decoder takes the file buffer. Tracks
+       * joined at the end of the previous one are parsed ahead in the probe
+       * buffer, without it their entries are filled after the playback
+       * stops.
+       */
+      if (player->metadata != NULL
+          && metadataTableAt(player->metadata, current) == NULL)
+      {
+        updateMetadata(player, node, current, &info);
+      }
+#endif
+
+      resetPlayback(player, node, current, &info);
+      requestChunkDecoding(player);
+
+      /* Saved point is outdated after any other track was started */
+      player->resume.pending = false;
+
+      player->stateCallback(player->stateCallbackArgument, PLAYER_PLAYING);
+    }
+    else
+    {
+      player->stateCallback(player->stateCallbackArgument, PLAYER_STOPPED);
+    }
+  }
+  else
+  {
+    wqAdd(WQ_DEFAULT, abortPlayingTask, player);
+  }
+}
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_MP3
+static size_t getFrameLengthMP3(const uint8_t *frame,
+    const MP3FrameInfo *frameInfo)
+{
+  const bool mpeg1 = (frame[1] & 0x18) == 0x18;
+  const size_t padding = (frame[2] >> 1) & 1;
+
+  if (!frameInfo->samprate)
+    return 0;
+
+  return (mpeg1 ? 144 : 72) * (size_t)frameInfo->bitrate
+      / (size_t)frameInfo->samprate + padding;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_MP3
+/*
+ * Checks that the frame is followed by a frame of the same stream, so false
+ * sync words in tags and in audio data are rejected.
+ */
+static bool isFrameSequenceMP3(const uint8_t *frame, size_t available,
+    const MP3FrameInfo *frameInfo)
+{
+  /* Free format frames have no length in the header */
+  if (!frameInfo->bitrate)
+    return true;
+
+  const size_t frameLength = getFrameLengthMP3(frame, frameInfo);
+  MP3FrameInfo nextInfo;
+
+  if (frameLength + 4 > available)
+    return false;
+  if (!parseFrameHeaderMP3(frame + frameLength, available - frameLength,
+      &nextInfo))
+  {
+    return false;
+  }
+
+  return nextInfo.layer == frameInfo->layer
+      && nextInfo.version == frameInfo->version
+      && nextInfo.samprate == frameInfo->samprate
+      && nextInfo.nChans == frameInfo->nChans;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_MP3
+static bool parseHeaderMP3(struct Player *player, struct FsNode *node,
+    struct TrackInfo *info)
+{
+  static const FsLength fileScanLength = 65536;
+  FsLength headerPosition;
+  FsLength length;
+  size_t count;
+
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK || length == 0)
+    return false;
+  if (!readTrackData(player, node, 0, &count))
+    return false;
+
+  /* Jump over the ID3v2 tag instead of searching for a sync word in it */
+  headerPosition = getTagLengthID3(player->scratch, count);
+
+  if (headerPosition)
+  {
+    if (headerPosition >= length)
+      return false;
+    if (!readTrackData(player, node, headerPosition, &count))
+      return false;
+  }
+
+  const FsLength scanEnd = MIN(headerPosition + fileScanLength, length);
+
+  while (count > 0)
+  {
+    size_t bufferPosition = 0;
+    size_t processed = count;
+
+    while (bufferPosition < count)
+    {
+      const int offset = MP3FindSyncWord(player->scratch + bufferPosition,
+          count - bufferPosition);
+
+      if (offset < 0)
+        break;
+
+      bufferPosition += (size_t)offset;
+
+      uint8_t * const frame = player->scratch + bufferPosition;
+      const size_t available = count - bufferPosition;
+      MP3FrameInfo frameInfo;
+
+      if (parseFrameHeaderMP3(frame, available, &frameInfo))
+      {
+        const size_t frameLength = getFrameLengthMP3(frame, &frameInfo);
+        const FsLength frameEnd =
+            headerPosition + (FsLength)(bufferPosition + frameLength);
+        const bool last = frameEnd + 4 > length;
+
+        if (!last && frameLength + 4 > available && bufferPosition > 0)
+        {
+          /* Header of the next frame is not buffered, read from this frame */
+          processed = bufferPosition;
+          break;
+        }
+
+        if (last || isFrameSequenceMP3(frame, available, &frameInfo))
+        {
+          /* Skip the tag frame, it contains no audio data */
+          const size_t skip = parseXingHeaderMP3(frame, available,
+              &frameInfo, info);
+
+          info->end = length;
+          info->offset = headerPosition + (FsLength)(bufferPosition + skip);
+          info->offset &= ~(sizeof(void *) - 1);
+          info->position = info->offset;
+          info->rate = (uint32_t)frameInfo.samprate;
+          info->channels = (uint8_t)frameInfo.nChans;
+          info->block = 0;
+          info->width = sizeof(short);
+          info->depth = 16;
+
+          if (!info->duration && frameInfo.bitrate > 0)
+          {
+            /* Constant bit rate stream without a tag */
+            info->duration = (uint32_t)((info->end - info->offset) * 8000
+                / (uint64_t)frameInfo.bitrate);
+          }
+
+          return true;
+        }
+      }
+
+      ++bufferPosition;
+    }
+
+    headerPosition += (FsLength)processed;
+
+    if (headerPosition >= scanEnd)
+      break;
+    if (!readTrackData(player, node, headerPosition, &count))
+      return false;
+  }
+
+  return false;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Parses the header of a Layer III frame without the decoder instance, so
+ * files are probed while the memory of the decoder is used by AAC tracks.
+ */
+static bool parseFrameHeaderMP3(const uint8_t *frame, size_t available,
+    MP3FrameInfo *frameInfo)
+{
+  static const uint16_t bitrates[2][15] = {
+      {0, 32, 40, 48, 56, 64, 80, 96, 112, 128, 160, 192, 224, 256, 320},
+      {0, 8, 16, 24, 32, 40, 48, 56, 64, 80, 96, 112, 128, 144, 160}
+  };
+  static const uint16_t rates[3] = {44100, 48000, 32000};
+
+  if (available < 4 || frame[0] != 0xFF || (frame[1] & 0xE0) != 0xE0)
+    return false;
+
+  /* Version 1, 2 and 2.5 are encoded as 3, 2 and 0 */
+  const unsigned int version = (frame[1] >> 3) & 0x03;
+  const unsigned int layer = (frame[1] >> 1) & 0x03;
+  const unsigned int bitrate = frame[2] >> 4;
+  const unsigned int rate = (frame[2] >> 2) & 0x03;
+
+  if (version == 1 || layer != 1 || bitrate == 15 || rate == 3)
+    return false;
+
+  const unsigned int index = version == 3 ? 0 : (version == 2 ? 1 : 2);
+
+  frameInfo->bitrate = bitrates[index ? 1 : 0][bitrate] * 1000;
+  frameInfo->nChans = (frame[3] >> 6) == 3 ? 1 : 2;
+  frameInfo->samprate = rates[rate] >> index;
+  frameInfo->bitsPerSample = 16;
+  frameInfo->outputSamps = 0;
+  frameInfo->layer = 3;
+  frameInfo->version = (int)index;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static size_t parseXingHeaderMP3(const uint8_t *frame, size_t available,
+    const MP3FrameInfo *frameInfo, struct TrackInfo *info)
+{
+  const bool mpeg1 = (frame[1] & 0x18) == 0x18;
+  const bool mono = (frame[3] & 0xC0) == 0xC0;
+  const size_t sideInfoLength = mpeg1 ? (mono ? 17 : 32) : (mono ? 9 : 17);
+  const size_t frameLength = getFrameLengthMP3(frame, frameInfo);
+  const uint32_t frameSamples = mpeg1 ? 1152 : 576;
+
+  size_t position = 4 + sideInfoLength;
+
+  info->delay = 0;
+  info->duration = 0;
+  info->length = 0;
+  info->sample = 0;
+  info->indexed = false;
+
+  if (frameLength > available
+      || position + sizeof(struct XingHeader) > frameLength)
+  {
+    return 0;
+  }
+
+  const struct XingHeader * const xing =
+      (const struct XingHeader *)(frame + position);
+  const uint32_t id = fromBigEndian32(xing->id);
+
+  /* Identifiers "Xing" and "Info" */
+  if (id != 0x58696E67UL && id != 0x496E666FUL)
+    return 0;
+
+  const uint32_t flags = fromBigEndian32(xing->flags);
+  uint32_t frames = 0;
+
+  position += sizeof(struct XingHeader);
+
+  if (flags & XING_FLAG_FRAMES)
+  {
+    uint32_t value;
+
+    if (position + sizeof(value) > frameLength)
+      return frameLength;
+
+    memcpy(&value, frame + position, sizeof(value));
+    frames = fromBigEndian32(value);
+    position += sizeof(value);
+
+    info->duration = (uint32_t)((uint64_t)frames * frameSamples * 1000
+        / (uint32_t)frameInfo->samprate);
+  }
+  if (flags & XING_FLAG_BYTES)
+    position += sizeof(uint32_t);
+  if (flags & XING_FLAG_TOC)
+  {
+    if (position + sizeof(info->toc) > frameLength)
+      return frameLength;
+
+    memcpy(info->toc, frame + position, sizeof(info->toc));
+    info->indexed = frames != 0;
+    position += sizeof(info->toc);
+  }
+  if (flags & XING_FLAG_QUALITY)
+    position += sizeof(uint32_t);
+
+  if (position + sizeof(struct LameHeader) <= frameLength)
+  {
+    const struct LameHeader * const lame =
+        (const struct LameHeader *)(frame + position);
+
+    if (!memcmp(lame->encoder, "LAME", 4) || !memcmp(lame->encoder, "Lavc", 4))
+    {
+      const uint32_t delay = ((uint32_t)lame->delay[0] << 4)
+          | (lame->delay[1] >> 4);
+      const uint32_t tail = ((uint32_t)(lame->delay[1] & 0x0F) << 8)
+          | lame->delay[2];
+      const uint32_t total = frames * frameSamples;
+
+      info->delay = delay + MP3_DECODER_DELAY;
+
+      if (frames && total > delay + tail)
+        info->length = total - delay - tail;
+    }
+  }
+
+  return frameLength;
+}
+/*----------------------------------------------------------------------------*/
+static void prepareDecoderMP3(struct Player *player,
+    [[maybe_unused]] const struct TrackInfo *info)
+{
+#ifdef CONFIG_ENABLE_AAC
+  /* Memory of the AAC decoder is returned to the MP3 decoder */
+  if (player->mp3Decoder == NULL)
+  {
+    if (player->aacDecoder != NULL)
+    {
+      AACFreeDecoder(player->aacDecoder);
+      player->aacDecoder = NULL;
+    }
+
+    player->mp3Decoder = MP3InitDecoder();
+
+    if (player->mp3Decoder == NULL)
+    {
+      debugTrace("Player MP3 decoder allocation failed");
+      return;
+    }
+  }
+#endif
+
+  /* Main data of the previous track is not used by the new track */
+  resetDecoderMP3(player);
+}
+/*----------------------------------------------------------------------------*/
+static void resetDecoderMP3(struct Player *player)
+{
+  MP3DecInfo * const decoder = player->mp3Decoder;
+
+  /*
+   * Bit reservoir is emptied, the decoder skips frames referring to main
+   * data of previous frames until the reservoir is filled again.
+   */
+  decoder->mainDataBegin = 0;
+  decoder->mainDataBytes = 0;
+}
+/*----------------------------------------------------------------------------*/
+static bool seekMP3(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const FsLength length = info->end - info->offset;
+  FsLength position;
+
+  if (player->mp3Decoder == NULL)
+    return false;
+
+  if (info->indexed)
+  {
+    /* Interpolate between entries of the Xing seek table */
+    const uint64_t scaled = (uint64_t)time * TRACK_TOC_LENGTH;
+    const size_t entry = (size_t)(scaled / info->duration);
+    const uint64_t remainder = scaled - (uint64_t)entry * info->duration;
+    const uint32_t lower = info->toc[entry];
+    const uint32_t upper = entry < TRACK_TOC_LENGTH - 1 ?
+        info->toc[entry + 1] : 256;
+    const uint64_t fraction = (uint64_t)lower * info->duration
+        + (upper > lower ? (upper - lower) * remainder : 0);
+
+    position = length * fraction / ((uint64_t)info->duration * 256);
+  }
+  else
+  {
+    /* Estimation based on the average bit rate */
+    position = length * time / info->duration;
+  }
+
+  position = (info->offset + position) & ~(FsLength)(sizeof(void *) - 1);
+
+  size_t count = 0;
+
+  if (!readPlaybackData(player, position, player->buffer.raw,
+      sizeof(player->buffer), &count))
+  {
+    return false;
+  }
+
+  /* Main data of the previous position is not valid anymore */
+  resetDecoderMP3(player);
+
+  size_t bufferPosition = 0;
+
+  while (bufferPosition < count)
+  {
+    const int offset = MP3FindSyncWord(player->buffer.raw + bufferPosition,
+        count - bufferPosition);
+
+    if (offset < 0)
+    {
+      bufferPosition = count;
+      break;
+    }
+
+    bufferPosition += (size_t)offset;
+
+    /* Frame is valid when it is followed by another frame header */
+    uint8_t * const frame = player->buffer.raw + bufferPosition;
+    MP3FrameInfo frameInfo;
+
+    if (parseFrameHeaderMP3(frame, count - bufferPosition, &frameInfo))
+    {
+      const size_t frameLength = getFrameLengthMP3(frame, &frameInfo);
+
+      if (!frameLength || bufferPosition + frameLength + 4 > count)
+        break;
+
+      if (parseFrameHeaderMP3(frame + frameLength,
+          count - bufferPosition - frameLength, &frameInfo))
+      {
+        break;
+      }
+    }
+
+    ++bufferPosition;
+  }
+
+  player->bufferPosition = bufferPosition;
+  player->bufferSize = count;
+  info->position = position + (FsLength)count;
+  info->sample = info->delay + (uint32_t)((uint64_t)time * info->rate / 1000);
+
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_FLAC
+static bool parseHeaderFLAC(struct Player *player, struct FsNode *node,
+    struct TrackInfo *info)
+{
+  static const size_t blockHeaderLength = 4;
+  static const size_t markerLength = 4;
+
+  struct FlacStreamInfo stream;
+  FsLength length;
+  /* File position of the buffered data */
+  FsLength position = 0;
+  /* Position of the current metadata block header */
+  FsLength block = markerLength;
+  size_t count;
+
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK)
+    return false;
+  if (!readTrackData(player, node, position, &count))
+    return false;
+  if (count < markerLength + blockHeaderLength + FLAC_STREAMINFO_LENGTH)
+    return false;
+
+  /* Stream marker "fLaC" is followed by the STREAMINFO block */
+  if (memcmp(player->scratch, "fLaC", markerLength))
+    return false;
+  if ((player->scratch[markerLength] & 0x7F) != 0)
+    return false;
+  if (!flacParseStreamInfo(player->scratch + markerLength
+      + blockHeaderLength, &stream))
+  {
+    return false;
+  }
+
+  /* Samples are converted to stereo frames, the side channel fits in 32 bits */
+  if (!stream.channels || stream.channels > 2)
+    return false;
+  if (stream.depth < 4 || stream.depth > 24)
+    return false;
+  if (stream.maxBlockSize > FLAC_BLOCK_LENGTH)
+    return false;
+
+  while (1)
+  {
+    if (block + blockHeaderLength > length)
+      return false;
+
+    if (block + blockHeaderLength > position + count)
+    {
+      /* Block header is outside of the buffer, read a next part */
+      position = block;
+
+      if (!readTrackData(player, node, position, &count))
+        return false;
+      if (count < blockHeaderLength)
+        return false;
+    }
+
+    /* Skip "VORBIS_COMMENT", "SEEKTABLE", "PICTURE" and other blocks */
+    const uint8_t * const header = player->scratch + (block - position);
+    const bool last = (header[0] & 0x80) != 0;
+    const FsLength size = ((FsLength)header[1] << 16)
+        | ((FsLength)header[2] << 8) | header[3];
+
+    block += blockHeaderLength + size;
+
+    if (last)
+      break;
+  }
+
+  if (block >= length)
+    return false;
+
+  info->end = length;
+  info->offset = block;
+  info->position = info->offset;
+  info->rate = stream.rate;
+  info->delay = 0;
+  info->duration = (uint32_t)(stream.samples * 1000 / stream.rate);
+  info->length = (uint32_t)stream.samples;
+  info->sample = 0;
+  info->block = 0;
+  info->channels = stream.channels;
+  info->width = (uint8_t)((stream.depth + 7) >> 3);
+  info->depth = stream.depth;
+  info->indexed = false;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void prepareDecoderFLAC(struct Player *player,
+    const struct TrackInfo *info)
+{
+  flacDecoderReset(player->flacDecoder, info->rate, info->depth, 0);
+}
+/*----------------------------------------------------------------------------*/
+static bool seekFLAC(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const FsLength length = info->end - info->offset;
+  const uint64_t target = (uint64_t)time * info->rate / 1000;
+
+  /* Estimation based on the average bit rate, frames are found by sync codes */
+  FsLength position = info->offset + length * time / info->duration;
+
+  position &= ~(FsLength)(SECTOR_SIZE - 1);
+  if (position < info->offset)
+    position = info->offset;
+
+  /* Decoder drops samples of the first frame that precede the target */
+  flacDecoderReset(player->flacDecoder, info->rate, info->depth, target);
+
+  info->position = position;
+  info->sample = (uint32_t)target;
+
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_AAC
+static bool bufferSampleM4A(struct Player *player, FsLength position,
+    uint32_t size)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  struct Mp4Cursor * const cursor = &player->mp4;
+
+  if (position >= cursor->base
+      && position + size <= cursor->base + player->bufferSize)
+  {
+    return true;
+  }
+
+  if (position + size > info->end)
+    return false;
+
+  /* Align file read requests along file system sector size */
+  const FsLength base = position & ~(FsLength)(SECTOR_SIZE - 1);
+  const size_t chunk = (size_t)MIN(info->end - base,
+      (FsLength)sizeof(player->buffer));
+  size_t read;
+
+  if (!readPlaybackData(player, base, player->buffer.raw, chunk, &read)
+      || base + read < position + size)
+  {
+    return false;
+  }
+
+  cursor->base = base;
+  player->bufferPosition = 0;
+  player->bufferSize = read;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static int decodeFrameAAC(struct Player *player, unsigned char **input,
+    int *left, uint8_t *buffer, size_t *count)
+{
+  /* Mono frames are expanded to stereo after decoding */
+  const int error = AACDecode(player->aacDecoder, input, left,
+      (short *)buffer);
+
+  if (error == ERR_AAC_NONE)
+  {
+    AACFrameInfo frameInfo;
+
+    AACGetLastFrameInfo(player->aacDecoder, &frameInfo);
+
+    const size_t channels = (size_t)frameInfo.nChans;
+    const size_t samples = (size_t)frameInfo.outputSamps / channels;
+
+    player->playback.info.sample += (uint32_t)samples;
+    *count = pcmConvert(buffer, samples * channels * sizeof(short),
+        sizeof(short), channels);
+  }
+  else
+    *count = 0;
+
+  return error;
+}
+/*----------------------------------------------------------------------------*/
+static bool findBoxM4A(struct FsNode *node, FsLength start, FsLength end,
+    uint32_t type, FsLength *payload, FsLength *limit)
+{
+  FsLength position = start;
+
+  while (position + sizeof(struct Mp4Box) <= end)
+  {
+    struct Mp4Box box;
+
+    if (!readFileM4A(node, position, &box, sizeof(box)))
+      return false;
+
+    FsLength header = sizeof(box);
+    FsLength size = fromBigEndian32(box.size);
+
+    if (size == 1)
+    {
+      /* 64-bit box size follows the box type */
+      uint32_t value[2];
+
+      if (!readFileM4A(node, position + header, value, sizeof(value)))
+        return false;
+
+      size = ((FsLength)fromBigEndian32(value[0]) << 32)
+          | fromBigEndian32(value[1]);
+      header += sizeof(value);
+    }
+    else if (size == 0)
+    {
+      /* Box extends to the end of the enclosing box */
+      size = end - position;
+    }
+
+    if (size < header || size > end - position)
+      return false;
+
+    if (fromBigEndian32(box.type) == type)
+    {
+      *payload = position + header;
+      *limit = position + size;
+      return true;
+    }
+
+    position += size;
+  }
+
+  return false;
+}
+/*----------------------------------------------------------------------------*/
+static size_t getFrameLengthAAC(const uint8_t *frame, size_t available)
+{
+  if (available < ADTS_HEADER_LENGTH)
+    return 0;
+
+  /* Sync word, layer bits and a valid sampling frequency index */
+  if (frame[0] != 0xFF || (frame[1] & 0xF6) != 0xF0)
+    return 0;
+  if (((frame[2] >> 2) & 0x0F) >= ARRAY_SIZE(aacRateTable))
+    return 0;
+
+  /* Header is longer when the checksum is present */
+  const size_t header = (frame[1] & 0x01) ?
+      ADTS_HEADER_LENGTH : ADTS_HEADER_LENGTH + 2;
+  const size_t length = ((size_t)(frame[3] & 0x03) << 11)
+      | ((size_t)frame[4] << 3) | (frame[5] >> 5);
+
+  return length > header ? length : 0;
+}
+/*----------------------------------------------------------------------------*/
+static inline uint32_t getWordM4A(const uint8_t *data)
+{
+  uint32_t value;
+
+  memcpy(&value, data, sizeof(value));
+  return fromBigEndian32(value);
+}
+/*----------------------------------------------------------------------------*/
+static bool loadEntryM4A(struct Player *player, uint32_t index,
+    uint32_t *first)
+{
+  const struct Mp4Tables * const tables = &player->playback.info.tables;
+  struct Mp4Cursor * const cursor = &player->mp4;
+
+  if (index >= tables->mapCount)
+    return false;
+
+  /*
+   * Each entry contains the first chunk, samples per chunk and a sample
+   * description index. First chunk of the next entry is read as well.
+   */
+  const size_t count = index + 1 < tables->mapCount ? 4 : 3;
+  uint32_t entry[4];
+
+  if (!readFileM4A(player->playback.file,
+      tables->map + (FsLength)index * 3 * sizeof(uint32_t),
+      entry, count * sizeof(uint32_t)))
+  {
+    return false;
+  }
+
+  *first = fromBigEndian32(entry[0]);
+  cursor->entry = index;
+  cursor->run = fromBigEndian32(entry[1]);
+  cursor->next = count == 4 ? fromBigEndian32(entry[3]) : UINT32_MAX;
+
+  return *first > 0 && cursor->run > 0 && cursor->next > *first;
+}
+/*----------------------------------------------------------------------------*/
+static bool locateSampleM4A(struct Player *player, uint32_t index)
+{
+  const struct Mp4Tables * const tables = &player->playback.info.tables;
+  struct Mp4Cursor * const cursor = &player->mp4;
+  /* Index of the first sample of the current sample-to-chunk entry */
+  uint64_t base = 0;
+
+  if (index >= tables->samples)
+    return false;
+
+  for (uint32_t entry = 0; entry < tables->mapCount; ++entry)
+  {
+    uint32_t first;
+
+    if (!loadEntryM4A(player, entry, &first))
+      return false;
+
+    const uint32_t last = MIN(cursor->next, tables->chunkCount + 1);
+
+    if (last <= first)
+      return false;
+
+    const uint64_t samples = (uint64_t)(last - first) * cursor->run;
+
+    if (index < base + samples)
+    {
+      const uint32_t offset = (uint32_t)(index - base);
+      const uint32_t within = offset % cursor->run;
+
+      cursor->chunk = first + offset / cursor->run;
+      cursor->left = cursor->run - within;
+      cursor->sample = index - within;
+
+      if (!readChunkOffsetM4A(player, cursor->chunk, &cursor->position))
+        return false;
+
+      /* Skip preceding samples of the chunk */
+      while (cursor->sample < index)
+      {
+        uint32_t size;
+
+        if (!readSampleSizeM4A(player, cursor->sample, &size))
+          return false;
+
+        cursor->position += size;
+        ++cursor->sample;
+      }
+
+      return true;
+    }
+
+    base += samples;
+  }
+
+  return false;
+}
+/*----------------------------------------------------------------------------*/
+static bool nextSampleM4A(struct Player *player, FsLength *position,
+    uint32_t *size)
+{
+  const struct Mp4Tables * const tables = &player->playback.info.tables;
+  struct Mp4Cursor * const cursor = &player->mp4;
+
+  if (!cursor->left)
+  {
+    /* Current chunk is exhausted, continue from the next one */
+    if (++cursor->chunk > tables->chunkCount)
+      return false;
+
+    if (cursor->chunk >= cursor->next)
+    {
+      uint32_t first;
+
+      if (!loadEntryM4A(player, cursor->entry + 1, &first))
+        return false;
+    }
+
+    if (!readChunkOffsetM4A(player, cursor->chunk, &cursor->position))
+      return false;
+
+    cursor->left = cursor->run;
+  }
+
+  if (!readSampleSizeM4A(player, cursor->sample, size))
+    return false;
+
+  *position = cursor->position;
+  cursor->position += *size;
+  ++cursor->sample;
+  --cursor->left;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool parseConfigM4A(const uint8_t *data, size_t size,
+    struct TrackInfo *info)
+{
+  /* Version, flags and entry count precede the first sample entry */
+  static const size_t entryOffset = 8;
+  /* Fields of the audio sample entry before child boxes */
+  static const size_t entryLength = 36;
+
+  if (size < entryOffset + entryLength)
+    return false;
+
+  const uint8_t * const entry = data + entryOffset;
+  const size_t entrySize = MIN((size_t)getWordM4A(entry), size - entryOffset);
+
+  if (getWordM4A(entry + 4) != MP4_BOX_MP4A)
+    return false;
+
+  /* Sound descriptions of versions 1 and 2 have extra fields */
+  const unsigned int version = (entry[16] << 8) | entry[17];
+  size_t position = entryLength + (version == 1 ? 16 : (version == 2 ? 36 : 0));
+  const uint8_t *current = NULL;
+  const uint8_t *end = NULL;
+
+  while (position + sizeof(struct Mp4Box) <= entrySize)
+  {
+    const size_t boxSize = getWordM4A(entry + position);
+
+    if (boxSize < sizeof(struct Mp4Box) || boxSize > entrySize - position)
+      return false;
+
+    if (getWordM4A(entry + position + 4) == MP4_BOX_ESDS)
+    {
+      current = entry + position + sizeof(struct Mp4Box);
+      end = entry + position + boxSize;
+      break;
+    }
+
+    position += boxSize;
+  }
+
+  /* Descriptors of the "esds" box follow version and flags */
+  if (current == NULL || end - current < 4)
+    return false;
+  current += 4;
+
+  size_t length;
+
+  if (!readDescriptorM4A(&current, end, MP4_TAG_ES, &length) || length < 3)
+    return false;
+
+  /* Optional fields are selected by flags after the stream identifier */
+  const uint8_t flags = current[2];
+  size_t skip = 3;
+
+  if (flags & 0x80)
+    skip += 2;
+  if ((flags & 0x40) && skip < length)
+    skip += 1 + current[skip];
+  if (flags & 0x20)
+    skip += 2;
+
+  if (skip > length)
+    return false;
+  current += skip;
+
+  if (!readDescriptorM4A(&current, end, MP4_TAG_DECODER_CONFIG, &length)
+      || length < 13 || current[0] != MP4_OBJECT_AUDIO)
+  {
+    return false;
+  }
+  current += 13;
+
+  if (!readDescriptorM4A(&current, end, MP4_TAG_DECODER_INFO, &length)
+      || length < 2)
+  {
+    return false;
+  }
+
+  /* Audio specific configuration, explicit sampling rates are not supported */
+  const unsigned int type = current[0] >> 3;
+  const unsigned int index = ((current[0] & 0x07) << 1) | (current[1] >> 7);
+  const unsigned int channels = (current[1] >> 3) & 0x0F;
+
+  if (type != MP4_AUDIO_OBJECT_AAC_LC || index >= ARRAY_SIZE(aacRateTable))
+    return false;
+  if (!channels || channels > 2)
+    return false;
+
+  info->rate = aacRateTable[index];
+  info->channels = (uint8_t)channels;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool parseHeaderAAC(struct Player *player, struct FsNode *node,
+    struct TrackInfo *info)
+{
+  FsLength length;
+  FsLength offset = 0;
+  size_t count;
+
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK)
+    return false;
+  if (!readTrackData(player, node, offset, &count))
+    return false;
+
+  const uint8_t * const data = player->scratch;
+
+  /* Skip the ID3v2 tag */
+  offset = getTagLengthID3(data, count);
+
+  if (offset && !readTrackData(player, node, offset, &count))
+    return false;
+
+  /* Stream should start with two consecutive frames of the same format */
+  const size_t first = getFrameLengthAAC(data, count);
+
+  if (!first || first > count)
+    return false;
+  if (!getFrameLengthAAC(data + first, count - first))
+    return false;
+  if ((data[2] & 0xFD) != (data[first + 2] & 0xFD))
+    return false;
+  if ((data[3] & 0xC0) != (data[first + 3] & 0xC0))
+    return false;
+
+  const unsigned int profile = data[2] >> 6;
+  const unsigned int index = (data[2] >> 2) & 0x0F;
+  const unsigned int channels = ((data[2] & 0x01) << 2) | (data[3] >> 6);
+
+  /* Profile field contains the audio object type minus one */
+  if (profile != MP4_AUDIO_OBJECT_AAC_LC - 1)
+    return false;
+  if (!channels || channels > 2)
+    return false;
+
+  /* Duration is estimated from the average length of buffered frames */
+  size_t position = 0;
+  size_t frames = 0;
+
+  while (position < count)
+  {
+    const size_t frameLength = getFrameLengthAAC(data + position,
+        count - position);
+
+    if (!frameLength || frameLength > count - position)
+      break;
+
+    position += frameLength;
+    ++frames;
+  }
+
+  info->end = length;
+  info->offset = offset;
+  info->position = info->offset;
+  info->rate = aacRateTable[index];
+  info->delay = 0;
+  info->duration = (uint32_t)((length - offset) * frames * AAC_MAX_NSAMPS
+      * 1000 / ((uint64_t)position * info->rate));
+  info->length = 0;
+  info->sample = 0;
+  info->block = 0;
+  info->channels = (uint8_t)channels;
+  info->width = sizeof(short);
+  info->depth = 16;
+  info->indexed = false;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool parseHeaderM4A(struct Player *player, struct FsNode *node,
+    struct TrackInfo *info)
+{
+  struct Mp4Box box;
+  FsLength length;
+  FsLength movie;
+  FsLength movieEnd;
+
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK)
+    return false;
+
+  /* File begins with the "ftyp" box */
+  if (!readFileM4A(node, 0, &box, sizeof(box)))
+    return false;
+  if (fromBigEndian32(box.type) != MP4_BOX_FTYP)
+    return false;
+
+  if (!findBoxM4A(node, 0, length, MP4_BOX_MOOV, &movie, &movieEnd))
+    return false;
+
+  FsLength position = movie;
+  FsLength track;
+  FsLength trackEnd;
+
+  /* First audio track is played */
+  while (findBoxM4A(node, position, movieEnd, MP4_BOX_TRAK, &track,
+      &trackEnd))
+  {
+    if (parseTrackM4A(player, node, track, trackEnd, info))
+    {
+      /* Positions of samples are stored in the sample tables */
+      info->end = length;
+      info->offset = 0;
+      info->position = 0;
+      info->delay = 0;
+      info->sample = 0;
+      info->block = 0;
+      info->width = sizeof(short);
+      info->depth = 16;
+      info->indexed = false;
+
+      return true;
+    }
+
+    position = trackEnd;
+  }
+
+  return false;
+}
+/*----------------------------------------------------------------------------*/
+static bool parseTrackM4A(struct Player *player, struct FsNode *node,
+    FsLength start, FsLength end, struct TrackInfo *info)
+{
+  struct Mp4Tables tables;
+  uint8_t header[32];
+  uint32_t words[3];
+  FsLength box;
+  FsLength boxEnd;
+  FsLength media;
+  FsLength mediaEnd;
+  FsLength table;
+  FsLength tableEnd;
+
+  if (!findBoxM4A(node, start, end, MP4_BOX_MDIA, &media, &mediaEnd))
+    return false;
+
+  /* Handler type follows version, flags and a pre-defined field */
+  if (!findBoxM4A(node, media, mediaEnd, MP4_BOX_HDLR, &box, &boxEnd))
+    return false;
+  if (!readFileM4A(node, box, words, sizeof(words)))
+    return false;
+  if (fromBigEndian32(words[2]) != MP4_HANDLER_SOUN)
+    return false;
+
+  /* Media header contains the time scale and the duration */
+  if (!findBoxM4A(node, media, mediaEnd, MP4_BOX_MDHD, &box, &boxEnd))
+    return false;
+
+  const size_t headerLength = (size_t)MIN(boxEnd - box,
+      (FsLength)sizeof(header));
+  uint64_t duration;
+  uint32_t scale;
+
+  if (headerLength < 20 || !readFileM4A(node, box, header, headerLength))
+    return false;
+
+  if (header[0] == 1)
+  {
+    /* Version 1 with 64-bit time fields */
+    if (headerLength < 32)
+      return false;
+
+    scale = getWordM4A(header + 20);
+    duration = ((uint64_t)getWordM4A(header + 24) << 32)
+        | getWordM4A(header + 28);
+  }
+  else
+  {
+    scale = getWordM4A(header + 12);
+    duration = getWordM4A(header + 16);
+  }
+
+  if (!scale)
+    return false;
+
+  /* Sample tables are placed in the "stbl" box inside the "minf" box */
+  if (!findBoxM4A(node, media, mediaEnd, MP4_BOX_MINF, &box, &boxEnd))
+    return false;
+  if (!findBoxM4A(node, box, boxEnd, MP4_BOX_STBL, &table, &tableEnd))
+    return false;
+
+  size_t count;
+
+  if (!findBoxM4A(node, table, tableEnd, MP4_BOX_STSD, &box, &boxEnd))
+    return false;
+  if (!readTrackData(player, node, box, &count))
+    return false;
+  if (!parseConfigM4A(player->scratch,
+      (size_t)MIN(boxEnd - box, (FsLength)count), info))
+  {
+    return false;
+  }
+
+  /* Sample size table: version, flags, common size and sample count */
+  if (!findBoxM4A(node, table, tableEnd, MP4_BOX_STSZ, &box, &boxEnd))
+    return false;
+  if (!readFileM4A(node, box, words, sizeof(words)))
+    return false;
+
+  tables.size = fromBigEndian32(words[1]);
+  tables.samples = fromBigEndian32(words[2]);
+  tables.sizes = box + sizeof(words);
+
+  if (!tables.size && tables.sizes
+      + (FsLength)tables.samples * sizeof(uint32_t) > boxEnd)
+  {
+    return false;
+  }
+
+  /* Chunk offset tables with 32-bit or 64-bit entries */
+  if (findBoxM4A(node, table, tableEnd, MP4_BOX_STCO, &box, &boxEnd))
+    tables.wide = false;
+  else if (findBoxM4A(node, table, tableEnd, MP4_BOX_CO64, &box, &boxEnd))
+    tables.wide = true;
+  else
+    return false;
+
+  if (!readFileM4A(node, box, words, 2 * sizeof(uint32_t)))
+    return false;
+
+  tables.chunkCount = fromBigEndian32(words[1]);
+  tables.chunks = box + 2 * sizeof(uint32_t);
+
+  /* Sample-to-chunk table */
+  if (!findBoxM4A(node, table, tableEnd, MP4_BOX_STSC, &box, &boxEnd))
+    return false;
+  if (!readFileM4A(node, box, words, 2 * sizeof(uint32_t)))
+    return false;
+
+  tables.mapCount = fromBigEndian32(words[1]);
+  tables.map = box + 2 * sizeof(uint32_t);
+
+  if (!tables.samples || !tables.chunkCount || !tables.mapCount)
+    return false;
+
+  info->tables = tables;
+  info->duration = (uint32_t)(duration * 1000 / scale);
+  info->length = tables.samples * AAC_MAX_NSAMPS;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Decoders share the heap memory: the AAC decoder stays allocated after
+ * AAC tracks and is replaced with the MP3 decoder only when an MP3 track
+ * is started, tracks of the same format are joined without heap operations.
+ */
+static void prepareDecoderAAC(struct Player *player,
+    const struct TrackInfo *info)
+{
+  player->mp4.base = 0;
+  player->mp4.chunk = 0;
+  player->mp4.cached = 0;
+
+  if (player->aacDecoder == NULL)
+  {
+#ifdef CONFIG_ENABLE_MP3
+    MP3FreeDecoder(player->mp3Decoder);
+    player->mp3Decoder = NULL;
+#endif
+
+    player->aacDecoder = AACInitDecoder();
+
+    if (player->aacDecoder == NULL)
+    {
+      debugTrace("Player AAC decoder allocation failed");
+      return;
+    }
+  }
+  else
+  {
+    AACDecInfo * const decoder = player->aacDecoder;
+
+    /* Stream format is detected again after raw blocks of MP4 files */
+    AACFlushCodec(player->aacDecoder);
+    decoder->format = AAC_FF_Unknown;
+  }
+
+  if (info->decoder == &decoderM4A)
+  {
+    /* Samples of MP4 files are raw data blocks without headers */
+    AACFrameInfo frameInfo = {
+        .nChans = info->channels,
+        .sampRateCore = (int)info->rate,
+        .profile = AAC_PROFILE_LC
+    };
+
+    AACSetRawBlockParams(player->aacDecoder, 0, &frameInfo);
+  }
+}
+/*----------------------------------------------------------------------------*/
+static bool readChunkOffsetM4A(struct Player *player, uint32_t chunk,
+    FsLength *position)
+{
+  const struct Mp4Tables * const tables = &player->playback.info.tables;
+  const FsLength index = chunk - 1;
+  uint32_t value[2];
+
+  if (tables->wide)
+  {
+    if (!readFileM4A(player->playback.file,
+        tables->chunks + index * sizeof(value), value, sizeof(value)))
+    {
+      return false;
+    }
+
+    *position = ((FsLength)fromBigEndian32(value[0]) << 32)
+        | fromBigEndian32(value[1]);
+  }
+  else
+  {
+    if (!readFileM4A(player->playback.file,
+        tables->chunks + index * sizeof(value[0]), value, sizeof(value[0])))
+    {
+      return false;
+    }
+
+    *position = fromBigEndian32(value[0]);
+  }
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readDescriptorM4A(const uint8_t **data, const uint8_t *end,
+    uint8_t tag, size_t *length)
+{
+  const uint8_t *current = *data;
+  size_t value = 0;
+
+  if (current >= end || *current++ != tag)
+    return false;
+
+  /* Length is coded in up to four 7-bit bytes */
+  for (unsigned int i = 0; i < 4; ++i)
+  {
+    if (current >= end)
+      return false;
+
+    const uint8_t byte = *current++;
+
+    value = (value << 7) | (byte & 0x7F);
+    if (!(byte & 0x80))
+      break;
+  }
+
+  if (value > (size_t)(end - current))
+    return false;
+
+  *data = current;
+  *length = value;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readFileM4A(struct FsNode *node, FsLength position, void *buffer,
+    size_t length)
+{
+  size_t count = 0;
+  enum Result res;
+
+  for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
+  {
+    res = fsNodeRead(node, FS_NODE_DATA, position, buffer, length, &count);
+
+    if (res == E_OK)
+      break;
+  }
+
+  return res == E_OK && count == length;
+}
+/*----------------------------------------------------------------------------*/
+static bool readSampleSizeM4A(struct Player *player, uint32_t index,
+    uint32_t *size)
+{
+  const struct Mp4Tables * const tables = &player->playback.info.tables;
+  struct Mp4Cursor * const cursor = &player->mp4;
+
+  if (index >= tables->samples)
+    return false;
+
+  if (tables->size)
+  {
+    *size = tables->size;
+    return true;
+  }
+
+  if (index < cursor->first || index - cursor->first >= cursor->cached)
+  {
+    /* Sizes are read in groups to reduce the number of file reads */
+    const uint32_t count = MIN(tables->samples - index,
+        (uint32_t)MP4_SIZE_CACHE_LENGTH);
+
+    if (!readFileM4A(player->playback.file,
+        tables->sizes + (FsLength)index * sizeof(uint32_t),
+        cursor->sizes, count * sizeof(uint32_t)))
+    {
+      return false;
+    }
+
+    for (uint32_t i = 0; i < count; ++i)
+      cursor->sizes[i] = fromBigEndian32(cursor->sizes[i]);
+
+    cursor->first = index;
+    cursor->cached = count;
+  }
+
+  *size = cursor->sizes[index - cursor->first];
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool seekAAC(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const FsLength length = info->end - info->offset;
+  FsLength position;
+  size_t count;
+
+  if (player->aacDecoder == NULL)
+    return false;
+
+  /* Estimation based on the average bit rate */
+  position = (info->offset + length * time / info->duration)
+      & ~(FsLength)(SECTOR_SIZE - 1);
+  if (position < info->offset)
+    position = info->offset;
+
+  if (!readTrackData(player, player->playback.file, position, &count))
+    return false;
+
+  size_t bufferPosition = 0;
+
+  while (bufferPosition < count)
+  {
+    /* Frame is valid when it is followed by another frame header */
+    const uint8_t * const frame = player->scratch + bufferPosition;
+    const size_t frameLength = getFrameLengthAAC(frame,
+        count - bufferPosition);
+
+    if (frameLength && frameLength < count - bufferPosition
+        && getFrameLengthAAC(frame + frameLength,
+            count - bufferPosition - frameLength))
+    {
+      break;
+    }
+
+    ++bufferPosition;
+  }
+
+  AACFlushCodec(player->aacDecoder);
+
+  player->bufferPosition = bufferPosition;
+  player->bufferSize = count;
+  info->position = position + (FsLength)count;
+  info->sample = (uint32_t)((uint64_t)time * info->rate / 1000);
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool seekM4A(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const uint32_t index = (uint32_t)((uint64_t)time * info->rate / 1000
+      / AAC_MAX_NSAMPS);
+
+  if (player->aacDecoder == NULL)
+    return false;
+
+  player->mp4.base = 0;
+  if (!locateSampleM4A(player, index))
+    return false;
+
+  AACFlushCodec(player->aacDecoder);
+  info->sample = index * AAC_MAX_NSAMPS;
+
+  return true;
+}
+#endif
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_OPUS
+/*
+ * Searches for the granule position of the last page of the logical stream,
+ * pages are scanned backwards from the end of the file.
+ */
+static bool findGranuleOPUS(struct Player *player, struct FsNode *node,
+    FsLength start, FsLength end, uint32_t serial, uint64_t *granule)
+{
+  /* Page length is limited to 65307 bytes */
+  static const FsLength scanLength = 65536 + PLAYER_BUFFER_LENGTH;
+  /* Overlap of windows for page headers crossing window boundaries */
+  static const size_t overlap = OGG_PAGE_HEADER_LENGTH + OGG_MAX_SEGMENTS;
 
-  struct FsNode * const node = fsOpenNode(player->handle,
-      pathArrayAt(&player->tracks, position)->data);
+  FsLength position = end;
 
-  if (node != NULL)
+  while (position > start && end - position < scanLength)
   {
-    if (parseHeaderWAV(player, node, info))
-    {
-      info->type = TRACK_WAV;
-    }
-#ifdef CONFIG_ENABLE_MP3
-    else if (parseHeaderMP3(player, node, info))
+    FsLength window = start;
+    size_t count;
+
+    if (position - start > PLAYER_BUFFER_LENGTH)
     {
-      info->type = TRACK_MP3;
+      window = (position - PLAYER_BUFFER_LENGTH)
+          & ~(FsLength)(SECTOR_SIZE - 1);
+      window = MAX(window, start);
     }
-#endif
-    else
+
+    if (!readTrackData(player, node, window, &count))
+      return false;
+
+    for (size_t index = count; index > 0; --index)
     {
-      info->type = TRACK_UNKNOWN;
+      struct OggPageHeader page;
+      size_t length;
+
+      if (!oggParsePageHeader(player->scratch + index - 1,
+          count - index + 1, &page, &length))
+      {
+        continue;
+      }
+
+      if (page.serial == serial && page.granule != OGG_GRANULE_UNKNOWN)
+      {
+        *granule = page.granule;
+        return true;
+      }
     }
+
+    if (window == start)
+      break;
+
+    position = window + overlap;
   }
 
-  return node;
+  return false;
 }
 /*----------------------------------------------------------------------------*/
-static void playTrack(struct Player *player, size_t start, int dir)
+static bool parseHeaderOPUS(struct Player *player, struct FsNode *node,
+    struct TrackInfo *info)
 {
-  const size_t count = pathArraySize(&player->tracks);
+  /* Identification header of the channel mapping family 0 */
+  static const size_t headLength = 19;
 
-  if (player->handle == NULL || !count || start >= count)
-    return;
+  struct OggPageHeader page;
+  FsLength length;
+  size_t count;
+  size_t pageLength;
 
-  struct TrackInfo info;
-  struct FsNode *node = NULL;
-  size_t current = start;
-  bool error = false;
+  if (player->opusDecoder == NULL)
+    return false;
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK)
+    return false;
+  if (!readTrackData(player, node, 0, &count))
+    return false;
 
-  resetPlayback(player, NULL, 0, NULL);
+  const uint8_t * const data = player->scratch;
 
-  do
+  /* First page contains only the identification header */
+  if (!oggParsePageHeader(data, count, &page, &pageLength))
+    return false;
+  if (!(page.flags & OGG_PAGE_FIRST) || page.segments != 1)
+    return false;
+  if (pageLength > count || data[OGG_PAGE_HEADER_LENGTH] < headLength)
+    return false;
+
+  const uint8_t * const head = data + OGG_PAGE_HEADER_LENGTH + 1;
+  uint16_t preSkip;
+  int16_t gain;
+
+  if (memcmp(head, "OpusHead", 8))
+    return false;
+
+  /* Only major version 0 is supported */
+  if ((head[8] & 0xF0) != 0)
+    return false;
+
+  /* Only mono and stereo streams without channel mapping tables */
+  if (!head[9] || head[9] > 2 || head[18] != 0)
+    return false;
+
+  memcpy(&preSkip, head + 10, sizeof(preSkip));
+  memcpy(&gain, head + 16, sizeof(gain));
+
+  const uint32_t serial = page.serial;
+  const uint8_t channels = head[9];
+  FsLength position = pageLength;
+  bool tags = false;
+
+  /* Audio data begins on the first page after comment header pages */
+  while (position < length)
   {
-    node = openTrack(player, current, &info);
+    if (!readTrackData(player, node, position, &count))
+      return false;
+    if (!oggParsePageHeader(data, count, &page, &pageLength))
+      return false;
 
-    if (node != NULL)
+    if (page.serial == serial)
     {
-      if (info.type == TRACK_UNKNOWN)
+      if (!(page.flags & OGG_PAGE_CONTINUED))
       {
-        fsNodeFree(node);
-        node = NULL;
-
-        if (dir > 0)
-        {
-          /* Try to play a next track */
-          current = (current == count - 1) ? 0 : current + 1;
-        }
-        else
-        {
-          /* Try to play a previous track */
-          current = (current == 0) ? count - 1 : current - 1;
-        }
+        if (tags)
+          break;
+        tags = true;
       }
-      else
-        break;
-    }
-    else
-    {
-      error = true;
-      break;
     }
+
+    position += pageLength;
   }
-  while (current != start);
 
-  if (!error)
-  {
-    if (node != NULL)
-    {
-      resetPlayback(player, node, current, &info);
-      wqAdd(WQ_DEFAULT, fetchNextChunkTask, player);
+  if (position >= length)
+    return false;
 
-      player->stateCallback(player->stateCallbackArgument, PLAYER_PLAYING);
-    }
-    else
-    {
-      player->stateCallback(player->stateCallbackArgument, PLAYER_STOPPED);
-    }
+  uint64_t granule;
+
+  info->end = length;
+  info->offset = position;
+  info->position = info->offset;
+  info->rate = OPUS_RATE;
+  info->delay = fromLittleEndian16(preSkip);
+  info->duration = 0;
+  info->length = 0;
+  info->sample = 0;
+  info->serial = serial;
+  info->block = 0;
+  info->gain = (int16_t)fromLittleEndian16((uint16_t)gain);
+  info->channels = channels;
+  info->width = sizeof(short);
+  info->depth = 16;
+  info->indexed = false;
+
+  if (findGranuleOPUS(player, node, position, length, serial, &granule)
+      && granule > info->delay && granule - info->delay <= UINT32_MAX)
+  {
+    info->length = (uint32_t)(granule - info->delay);
+    info->duration = (uint32_t)((uint64_t)info->length * 1000 / OPUS_RATE);
   }
-  else
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static void prepareDecoderOPUS(struct Player *player,
+    const struct TrackInfo *info)
+{
+  opus_decoder_init(player->opusDecoder, OPUS_RATE, info->channels);
+  opus_decoder_ctl(player->opusDecoder, OPUS_SET_GAIN(info->gain));
+  oggReaderReset(player->oggReader, info->serial, false);
+}
+/*----------------------------------------------------------------------------*/
+static bool seekOPUS(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+
+  opus_decoder_ctl(player->opusDecoder, OPUS_RESET_STATE);
+
+  if (!time)
   {
-    wqAdd(WQ_DEFAULT, abortPlayingTask, player);
+    info->position = info->offset;
+    info->sample = 0;
+    oggReaderReset(player->oggReader, info->serial, false);
+    return true;
   }
+
+  /* Estimation based on the average bit rate */
+  const FsLength length = info->end - info->offset;
+  const FsLength position = (info->offset + length * time / info->duration)
+      & ~(FsLength)(SECTOR_SIZE - 1);
+
+  info->position = MAX(position, info->offset);
+  oggReaderReset(player->oggReader, info->serial, true);
+
+  /*
+   * Reader skips packets until a page boundary with a known granule
+   * position, the first packet after it is dropped to get its position.
+   */
+  const uint8_t *packet;
+  size_t count;
+
+  if (oggReaderRead(player->oggReader, &packet, &count) != OGG_OK)
+    return false;
+
+  const int samples = count ? opus_packet_get_nb_samples(packet,
+      (opus_int32)count, OPUS_RATE) : 0;
+  const uint64_t sample = oggReaderGetOrigin(player->oggReader)
+      + (uint64_t)MAX(samples, 0);
+
+  info->sample = (uint32_t)MIN(sample, (uint64_t)UINT32_MAX);
+  return true;
 }
+#endif
 /*----------------------------------------------------------------------------*/
-#ifdef CONFIG_ENABLE_MP3
-static bool parseHeaderMP3(struct Player *player, struct FsNode *node,
+static bool parseHeaderWAV(struct Player *player, struct FsNode *node,
     struct TrackInfo *info)
 {
   static const FsLength fileScanLength = 65536;
-  FsLength headerPosition = 0;
+
+  struct WavFormatExtensible format;
   FsLength length;
+  /* File position of the buffered data */
+  FsLength position = 0;
+  /* Position of the current chunk header */
+  FsLength chunk = sizeof(struct RiffHeader);
+  size_t count;
+  bool formatFound = false;
 
-  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK || length == 0)
+  if (fsNodeLength(node, FS_NODE_DATA, &length) != E_OK)
+    return false;
+  if (!readTrackData(player, node, position, &count))
+    return false;
+  if (count < sizeof(struct RiffHeader))
     return false;
 
-  while (headerPosition < MIN(fileScanLength, length))
-  {
-    size_t count;
-    enum Result res;
+  const struct RiffHeader * const header =
+      (const struct RiffHeader *)player->scratch;
 
-    for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
+  if (fromBigEndian32(header->id) != RIFF_ID_RIFF)
+    return false;
+  if (fromBigEndian32(header->format) != RIFF_ID_WAVE)
+    return false;
+
+  while (chunk + sizeof(struct RiffChunk) <= MIN(length, fileScanLength))
+  {
+    if (chunk + sizeof(struct RiffChunk) > position + count)
     {
-      res = fsNodeRead(
-          node,
-          FS_NODE_DATA,
-          headerPosition,
-          player->buffer.raw,
-          sizeof(player->buffer),
-          &count
-      );
+      /* Chunk header is outside of the buffer, read a next part */
+      position = chunk;
 
-      if (res == E_OK)
-        break;
+      if (!readTrackData(player, node, position, &count))
+        return false;
+      if (count < sizeof(struct RiffChunk))
+        return false;
     }
 
-    if (res == E_OK && count == sizeof(player->buffer))
+    const struct RiffChunk * const entry =
+        (const struct RiffChunk *)(player->scratch + (chunk - position));
+    const uint32_t id = fromBigEndian32(entry->id);
+    const uint32_t size = fromLittleEndian32(entry->size);
+    const FsLength data = chunk + sizeof(struct RiffChunk);
+
+    if (id == RIFF_ID_FMT)
     {
-      size_t bufferPosition = 0;
+      const size_t formatSize = MIN(size, sizeof(format));
+
+      if (formatSize < sizeof(struct WavFormat))
+        return false;
 
-      while (bufferPosition < count)
+      if (data + formatSize > position + count)
       {
-        const int offset = MP3FindSyncWord(player->buffer.raw + bufferPosition,
-            count - bufferPosition);
+        position = data;
 
-        if (offset >= 0)
-        {
-          MP3FrameInfo frameInfo;
+        if (!readTrackData(player, node, position, &count))
+          return false;
+        if (count < formatSize)
+          return false;
+      }
 
-          const int error = MP3GetNextFrameInfo(player->mp3Decoder, &frameInfo,
-              player->buffer.raw + offset, count - offset);
+      memset(&format, 0, sizeof(format));
+      memcpy(&format, player->scratch + (data - position), formatSize);
+      formatFound = true;
+    }
+    else if (id == RIFF_ID_DATA)
+    {
+      if (!formatFound)
+        return false;
 
-          if (error == ERR_MP3_NONE)
-          {
-            info->end = length;
-            info->offset = headerPosition + (FsLength)offset;
-            info->offset &= ~(sizeof(void *) - 1);
-            info->position = info->offset;
-            info->rate = (uint32_t)frameInfo.samprate;
-            info->channels = (uint8_t)frameInfo.nChans;
-
-            return true;
-          }
-          else
-          {
-            bufferPosition += (size_t)offset + 1;
-          }
-        }
-        else
-          break;
-      }
+      /* Size is unknown or invalid in files that were not finalized */
+      const FsLength available = length > data ? length - data : 0;
+      const FsLength total = size && size <= available ? size : available;
+
+      return setupFormatWAV(&format, data, total, info);
     }
 
-    headerPosition += (FsLength)count;
+    /* Skip "LIST", "fact", "bext", "JUNK" and other chunks */
+    chunk = data + size + (size & 1);
   }
 
   return false;
 }
-#endif
 /*----------------------------------------------------------------------------*/
-static bool parseHeaderWAV(struct Player *player, struct FsNode *node,
-    struct TrackInfo *info)
+static void prepareDecoderADPCM(struct Player *player,
+    const struct TrackInfo *info)
+{
+  player->adpcm.channels = info->channels;
+  player->adpcm.groups = 0;
+}
+/*----------------------------------------------------------------------------*/
+static bool readPlaybackData(struct Player *player, FsLength position,
+    void *buffer, size_t length, size_t *count)
+{
+  const uint32_t timestamp = getTimestamp(player);
+  enum Result res = E_OK;
+
+  /* Mapped data is read from the volume without cluster chain lookups */
+  if (player->volume == NULL || !fatExtentMapRead(player->volume,
+      &player->playback.info.extents, position, buffer, length, count))
+  {
+    for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
+    {
+      res = fsNodeRead(
+          player->playback.file,
+          FS_NODE_DATA,
+          position,
+          buffer,
+          length,
+          count
+      );
+
+      if (res == E_OK)
+        break;
+    }
+  }
+
+  if (res != E_OK)
+    return false;
+
+  player->stats.bytes += (uint32_t)*count;
+  player->stats.reading += getTimestamp(player) - timestamp;
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool readTrackData(struct Player *player, struct FsNode *node,
+    FsLength position, size_t *count)
 {
-  size_t count;
   enum Result res;
 
   for (unsigned int retries = 0; retries < MAX_READ_RETRIES; ++retries)
@@ -502,63 +3110,65 @@ static bool parseHeaderWAV(struct Player *player, struct FsNode *node,
     res = fsNodeRead(
         node,
         FS_NODE_DATA,
-        0,
-        player->buffer.raw,
-        sizeof(struct WavHeader),
-        &count
+        position,
+        player->scratch,
+        PLAYER_BUFFER_LENGTH,
+        count
     );
 
     if (res == E_OK)
       break;
   }
 
-  if (res == E_OK && count == sizeof(struct WavHeader))
-  {
-    const struct WavHeader * const header = &player->buffer.wav;
-    const uint16_t channels = fromLittleEndian16(header->numChannels);
-    const uint16_t width = header->bitsPerSample >> 3;
-
-    if (fromBigEndian32(header->chunkId) != 0x52494646UL)
-      return false;
-    if (fromBigEndian32(header->subchunk1Id) != 0x666D7420UL)
-      return false;
-    if (fromBigEndian32(header->subchunk2Id) != 0x64617461UL)
-      return false;
-    if (fromLittleEndian16(header->audioFormat) != 1)
-      return false;
-    if (width != 2)
-      return false;
-
-    uint32_t alignment = channels * width;
-    uint32_t duration = fromLittleEndian32(header->subchunk2Size);
-
-    if (alignment < sizeof(void *))
-      alignment = sizeof(void *);
-
-    /* Align data size */
-    duration &= ~(alignment - 1);
-
-    info->end = sizeof(header) + duration;
-    info->offset = sizeof(header);
-    info->position = info->offset;
-    info->rate = fromLittleEndian32(header->sampleRate);
-    info->channels = (uint8_t)channels;
+  return res == E_OK;
+}
+/*----------------------------------------------------------------------------*/
+static void requestChunkDecoding(struct Player *player)
+{
+  const IrqState state = irqSave();
 
-    return true;
+  /* Only one decoding task may be in the work queue at a time */
+  if (!player->pcm.pending)
+  {
+    if (wqAdd(WQ_DEFAULT, fetchNextChunkTask, player) == E_OK)
+      player->pcm.pending = true;
   }
 
-  return false;
+  irqRestore(state);
+}
+/*----------------------------------------------------------------------------*/
+static void requestUpcomingTrack(struct Player *player)
+{
+  if (!player->upcoming.checked && !player->upcoming.pending)
+  {
+    if (wqAdd(WQ_DEFAULT, openUpcomingTask, player) == E_OK)
+      player->upcoming.pending = true;
+  }
+}
+/*----------------------------------------------------------------------------*/
+static void resetLocations(struct Player *player)
+{
+  for (size_t index = 0; index < player->locations.count; ++index)
+    player->locations.entries[index].sector = 0;
 }
 /*----------------------------------------------------------------------------*/
 static void resetPlayback(struct Player *player, struct FsNode *node,
     size_t index, const struct TrackInfo *info)
 {
   if (player->playback.file != NULL)
-    fsNodeFree(player->playback.file);
+    closeTrack(player);
+
+  closeUpcomingTrack(player);
+  resetStats(player);
+
+  /* Samples that are already sent to the DMA will be played to the end */
+  pcmRingDrop(&player->pcm.ring);
 
   player->bufferPosition = 0;
   player->bufferSize = 0;
   player->playback.stop = false;
+  player->playback.eof = false;
+  player->playback.next = false;
 
   if (node != NULL)
   {
@@ -573,26 +3183,180 @@ static void resetPlayback(struct Player *player, struct FsNode *node,
 
   if (node != NULL && info != NULL)
   {
+    const size_t capacity = player->txReq[0].capacity;
+    const size_t limit = player->pcm.ring.size - DECODE_CHUNK_LENGTH;
+    size_t level = (size_t)info->rate * PCM_FRAME_SIZE
+        * DECODE_AHEAD_TIME / 1000;
+
+    /* Keep the level aligned and high enough to fill at least one request */
+    level = MAX(MIN(level, limit), capacity) & ~(sizeof(uint32_t) - 1);
+
+    player->pcm.high = level;
+    player->pcm.low = level / 2;
+
+    const struct PcmFormat format = {
+        .rate = info->rate,
+        .channels = info->channels,
+        .width = PCM_OUTPUT_WIDTH
+    };
+
     player->playback.info = *info;
     player->playback.playing = true;
 
-    player->controlCallback(player->controlCallbackArgument,
-        info->rate, info->channels);
+    if (info->decoder->open != NULL)
+      info->decoder->open(player, info);
+
+    player->controlCallback(player->controlCallbackArgument, &format);
   }
   else
   {
+    player->pcm.high = 0;
+    player->pcm.low = 0;
+
     player->playback.info = (struct TrackInfo){
+        .decoder = NULL,
         .end = 0,
         .offset = 0,
         .position = 0,
         .rate = 0,
+        .delay = 0,
+        .duration = 0,
+        .length = 0,
+        .sample = 0,
+        .serial = 0,
+        .block = 0,
+        .gain = 0,
         .channels = 0,
-        .type = TRACK_UNKNOWN
+        .width = 0,
+        .depth = 0,
+        .indexed = false
     };
     player->playback.playing = false;
   }
 }
 /*----------------------------------------------------------------------------*/
+static void resetStats(struct Player *player)
+{
+  player->stats.timestamp = 0;
+  player->stats.gap = 0;
+  player->stats.refill = 0;
+  player->stats.frames = 0;
+  player->stats.peak = 0;
+  player->stats.peakFrames = 0;
+  player->stats.requests = 0;
+  player->stats.shortfall = 0;
+  player->stats.bytes = 0;
+  player->stats.reading = 0;
+  player->stats.underruns = 0;
+  player->stats.starving = false;
+}
+/*----------------------------------------------------------------------------*/
+static bool seekADPCM(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const size_t header = ADPCM_HEADER_LENGTH * info->channels;
+  const size_t group = ADPCM_GROUP_LENGTH * info->channels;
+  const uint32_t samples = (uint32_t)((info->block - header) / group
+      * ADPCM_GROUP_SAMPLES + 1);
+  const uint32_t block = (uint32_t)((uint64_t)time * info->rate / 1000
+      / samples);
+
+  /* Decoding starts from the beginning of the block */
+  info->position = MIN(info->offset + (FsLength)block * info->block,
+      info->end);
+  info->sample = block * samples;
+  player->adpcm.groups = 0;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool seekWAV(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+  const size_t width = info->channels * info->width;
+  const uint32_t sample = (uint32_t)((uint64_t)time * info->rate / 1000);
+
+  info->position = MIN(info->offset + (FsLength)sample * width, info->end);
+  info->sample = (uint32_t)((info->position - info->offset) / width);
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
+static bool setupFormatWAV(const struct WavFormatExtensible *format,
+    FsLength offset, FsLength size, struct TrackInfo *info)
+{
+  const uint16_t channels = fromLittleEndian16(format->base.numChannels);
+  const uint16_t depth = fromLittleEndian16(format->base.bitsPerSample);
+  const uint16_t block = fromLittleEndian16(format->base.blockAlign);
+  const uint32_t rate = fromLittleEndian32(format->base.sampleRate);
+  uint16_t type = fromLittleEndian16(format->base.audioFormat);
+
+  if (type == WAVE_FORMAT_EXTENSIBLE)
+  {
+    /* Format code is stored in the first bytes of the sub-format GUID */
+    type = (uint16_t)(format->subFormat[0] | (format->subFormat[1] << 8));
+  }
+
+  /* Samples are converted to stereo frames during playback */
+  if (!channels || channels > 2 || !rate)
+    return false;
+
+  if (type == WAVE_FORMAT_PCM)
+  {
+    const uint16_t width = depth >> 3;
+
+    if (!width || width > 4)
+      return false;
+
+    /* Skip an incomplete frame at the end of the data */
+    size -= size % (channels * width);
+
+    info->duration = (uint32_t)(size * 1000 / (rate * channels * width));
+    info->length = 0;
+    info->block = 0;
+    info->width = (uint8_t)width;
+    info->depth = (uint8_t)(width << 3);
+  }
+  else if (type == WAVE_FORMAT_IMA_ADPCM)
+  {
+    /* Block header is followed by interleaved groups of 4-bit samples */
+    const size_t header = ADPCM_HEADER_LENGTH * channels;
+    const size_t group = ADPCM_GROUP_LENGTH * channels;
+
+    if (depth != 4 || block <= header || (block - header) % group)
+      return false;
+
+    const uint32_t samples = (uint32_t)((block - header) / group
+        * ADPCM_GROUP_SAMPLES + 1);
+    const FsLength tail = size % block;
+    uint64_t total = (uint64_t)(size / block) * samples;
+
+    /* Last block of the stream may be shorter */
+    if (tail >= header)
+      total += (tail - header) / group * ADPCM_GROUP_SAMPLES + 1;
+
+    info->duration = (uint32_t)(total * 1000 / rate);
+    info->length = (uint32_t)total;
+    info->block = block;
+    info->decoder = &decoderADPCM;
+    info->width = sizeof(int16_t);
+    info->depth = 16;
+  }
+  else
+    return false;
+
+  info->end = offset + size;
+  info->offset = offset;
+  info->position = info->offset;
+  info->rate = rate;
+  info->delay = 0;
+  info->sample = 0;
+  info->channels = (uint8_t)channels;
+  info->indexed = false;
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
 static void shuffleTracks(PathArray *tracks, int (*random)(void))
 {
   const size_t count = pathArraySize(tracks);
@@ -618,6 +3382,28 @@ static void sortTracks(PathArray *tracks)
   );
 }
 /*----------------------------------------------------------------------------*/
+static void switchToUpcomingTrack(struct Player *player)
+{
+  closeTrack(player);
+  resetStats(player);
+
+  player->bufferPosition = 0;
+  player->bufferSize = 0;
+
+  player->playback.file = player->upcoming.file;
+  player->playback.index = player->upcoming.index;
+  player->playback.info = player->upcoming.info;
+  player->upcoming.file = NULL;
+  player->upcoming.checked = false;
+
+  const struct TrackDecoder * const decoder = player->playback.info.decoder;
+
+  if (decoder->open != NULL)
+    decoder->open(player, &player->playback.info);
+
+  player->stateCallback(player->stateCallbackArgument, PLAYER_PLAYING);
+}
+/*----------------------------------------------------------------------------*/
 static int trackCompare(const void *a, const void *b)
 {
   const FilePath * const pathA = a;
@@ -626,6 +3412,28 @@ static int trackCompare(const void *a, const void *b)
   return strcmp(pathA->data, pathB->data);
 }
 /*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+static void updateMetadata(struct Player *player, struct FsNode *node,
+    size_t index, const struct TrackInfo *info)
+{
+  struct MetadataTable * const table = player->metadata;
+  struct MetadataTags tags;
+
+  if (table == NULL || metadataTableAt(table, index) != NULL)
+    return;
+
+  /* Entry of an unsupported or unreadable file is stored without tags */
+  if (info->decoder == NULL || !metadataReadTags(node, player->scratch,
+      PLAYER_BUFFER_LENGTH, &tags))
+  {
+    memset(&tags, 0, sizeof(tags));
+  }
+
+  metadataTableStore(table, index, &tags,
+      info->decoder != NULL ? info->duration : 0);
+}
+#endif
+/*----------------------------------------------------------------------------*/
 static inline void abortPlayingTask(void *argument)
 {
   struct Player * const player = argument;
@@ -637,64 +3445,143 @@ static inline void abortPlayingTask(void *argument)
 static void fetchNextChunkTask(void *argument)
 {
   struct Player * const player = argument;
+  struct PcmRing * const ring = &player->pcm.ring;
 
-  if (player->playback.file == NULL)
+  /* Completion callbacks may request decoding again from now on */
+  player->pcm.pending = false;
+
+  if (player->playback.file == NULL || !player->playback.playing)
     return;
 
-  for (size_t index = 0; index < player->buffers; ++index)
+  const uint32_t timestamp = getTimestamp(player);
+
+  while (!player->playback.eof && pcmRingUsed(ring) < player->pcm.high)
   {
-    if (player->playback.info.position >= player->playback.info.end)
+    if (isTrackFinished(player))
     {
-      wqAdd(WQ_DEFAULT, playNextTask, player);
+      const struct TrackInfo * const current = &player->playback.info;
+      const struct TrackInfo * const upcoming = &player->upcoming.info;
+
+      if (!player->upcoming.checked)
+      {
+        /* Decoding is resumed by the opening task */
+        requestUpcomingTrack(player);
+        break;
+      }
+
+      /*
+       * Next track is already opened and parsed. All tracks are converted
+       * to stereo frames, so tracks with the same sample rate are joined
+       * without a gap, otherwise the ring is drained and the output is
+       * reconfigured.
+       */
+      if (player->upcoming.file != NULL && upcoming->rate == current->rate)
+      {
+        switchToUpcomingTrack(player);
+        continue;
+      }
+
+      player->playback.eof = true;
       break;
     }
 
-    if (player->txReq[index].length == 0)
-    {
-      size_t count = 0;
-      bool ok = false;
+    uint8_t * const buffer = pcmRingReserve(ring, DECODE_CHUNK_LENGTH);
 
-      switch ((enum TrackType)player->playback.info.type)
-      {
-        case TRACK_WAV:
-          ok = fetchNextChunkWAV(player, player->txReq[index].buffer,
-              player->txReq[index].capacity, &count);
-          break;
+    if (buffer == NULL)
+      break;
 
-#ifdef CONFIG_ENABLE_MP3
-        case TRACK_MP3:
-          ok = fetchNextChunkMP3(player, player->txReq[index].buffer,
-              player->txReq[index].capacity, &count);
-          break;
-#endif
+    size_t count = 0;
+    const bool ok = player->playback.info.decoder->fetch(player, buffer,
+        DECODE_CHUNK_LENGTH, &count);
 
-        default:
-          break;
-      }
+    if (!ok)
+    {
+      wqAdd(WQ_DEFAULT, abortPlayingTask, player);
+      return;
+    }
 
-      if (ok)
-      {
-        if (count >= MIN_BUFFER_LEVEL)
-        {
-          player->txReq[index].length = count;
-          streamEnqueue(player->tx, &player->txReq[index]);
-        }
-        else
-        {
-          wqAdd(WQ_DEFAULT, playNextTask, player);
-        }
-      }
-      else
-      {
-        wqAdd(WQ_DEFAULT, abortPlayingTask, player);
-      }
+    if (count > 0)
+    {
+      pcmRingCommit(ring, count);
+      player->stats.frames += count / PCM_FRAME_SIZE;
+    }
+    else
+    {
+      /* Skip the rest of the file */
+      player->bufferPosition = player->bufferSize;
+      player->playback.info.position = player->playback.info.end;
     }
   }
+
+  player->stats.refill += getTimestamp(player) - timestamp;
+
+  const struct TrackInfo * const info = &player->playback.info;
+
+  /* Next track is parsed in the probe buffer while the ring is full */
+  if (player->probe != NULL && !player->playback.eof
+      && info->position + UPCOMING_MARGIN >= info->end)
+  {
+    requestUpcomingTrack(player);
+  }
+
+  /* Start or resume the playback */
+  const IrqState state = irqSave();
+  dispatchAudioData(player);
+  irqRestore(state);
+}
+/*----------------------------------------------------------------------------*/
+static void openUpcomingTask(void *argument)
+{
+  struct Player * const player = argument;
+
+  player->upcoming.pending = false;
+
+  if (player->playback.file == NULL || player->upcoming.checked)
+    return;
+
+  /* File buffer is free only after the decoder has consumed all input */
+  if (player->probe != NULL)
+    player->scratch = player->probe;
+  else if (!isTrackFinished(player))
+    return;
+
+  player->upcoming.checked = true;
+
+  [[maybe_unused]] const bool opened = openUpcomingTrack(player);
+
+#ifdef CONFIG_ENABLE_METADATA
+  /* Tags are not parsed at the end of the current track */
+  if (opened && player->probe != NULL)
+  {
+    updateMetadata(player, player->upcoming.file, player->upcoming.index,
+        &player->upcoming.info);
+  }
+#endif
+
+  player->scratch = player->buffer.raw;
+
+  /* Decoding task may be waiting for the next track */
+  requestChunkDecoding(player);
 }
 /*----------------------------------------------------------------------------*/
-static inline void playNextTask(void *argument)
+static void playNextTask(void *argument)
 {
-  playerPlayNext(argument);
+  struct Player * const player = argument;
+  struct FsNode * const node = player->upcoming.file;
+
+  if (node != NULL)
+  {
+    /* Next track is already opened and parsed */
+    player->upcoming.file = NULL;
+    resetPlayback(player, node, player->upcoming.index, &player->upcoming.info);
+    requestChunkDecoding(player);
+
+    player->stateCallback(player->stateCallbackArgument, PLAYER_PLAYING);
+  }
+  else
+  {
+    playerPlayNext(player);
+  }
 }
 /*----------------------------------------------------------------------------*/
 static inline void stopPlayingTask(void *argument)
@@ -703,11 +3590,26 @@ static inline void stopPlayingTask(void *argument)
 
   if (player->playback.file != NULL)
   {
+    pcmRingDrop(&player->pcm.ring);
+
     player->bufferPosition = 0;
     player->bufferSize = 0;
     player->playback.info.position = player->playback.info.offset;
+    player->playback.info.sample = 0;
+
+    const struct TrackDecoder * const decoder = player->playback.info.decoder;
+
+    /* Decoder state of the stopped position is dropped */
+    if (decoder->open != NULL)
+      decoder->open(player, &player->playback.info);
+
     player->playback.playing = false;
     player->playback.stop = false;
+    player->playback.eof = false;
+    player->playback.next = false;
+    player->stats.starving = false;
+
+    closeUpcomingTrack(player);
   }
   else
   {
@@ -718,11 +3620,28 @@ static inline void stopPlayingTask(void *argument)
 }
 /*----------------------------------------------------------------------------*/
 bool playerInit(struct Player *player, struct Stream *rx, struct Stream *tx,
-    size_t buffers, size_t rxLength, size_t txLength, size_t trackCount,
-    void *rxArena, void *txArena, void *trackArena, int (*random)(void))
+    size_t buffers, size_t rxLength, size_t txLength, size_t pcmLength,
+    size_t trackCount, size_t opusLength, void *rxArena, void *pcmArena,
+    void *trackArena, void *opusArena, int (*random)(void))
 {
   if (rxLength > txLength)
     return false;
+  if (txLength + DECODE_CHUNK_LENGTH > pcmLength)
+    return false;
+
+#ifdef CONFIG_ENABLE_OPUS
+  /* Reader, decoder state and packet buffer are placed in the arena */
+  const size_t opusStateLength = (size_t)opus_decoder_get_size(2);
+
+  if (opusArena != NULL && sizeof(struct OggReader) + opusStateLength
+      + OPUS_PACKET_LENGTH > opusLength)
+  {
+    return false;
+  }
+#else
+  (void)opusLength;
+  (void)opusArena;
+#endif
 
   player->rxReq = malloc(sizeof(struct StreamRequest) * buffers);
   if (player->rxReq == NULL)
@@ -732,6 +3651,9 @@ bool playerInit(struct Player *player, struct Stream *rx, struct Stream *tx,
   if (player->txReq == NULL)
     goto free_rx;
 
+  if (!pointerQueueInit(&player->txQueue, buffers))
+    goto free_tx;
+
   if (trackArena != NULL)
   {
     player->preallocated = true;
@@ -741,7 +3663,7 @@ bool playerInit(struct Player *player, struct Stream *rx, struct Stream *tx,
   {
     player->preallocated = false;
     if (!pathArrayInit(&player->tracks, trackCount))
-      goto free_tx;
+      goto free_queue;
   }
 
 #ifdef CONFIG_ENABLE_MP3
@@ -752,6 +3674,36 @@ bool playerInit(struct Player *player, struct Stream *rx, struct Stream *tx,
   player->mp3Decoder = NULL;
 #endif
 
+#ifdef CONFIG_ENABLE_FLAC
+  player->flacDecoder = malloc(sizeof(struct FlacDecoder));
+  if (player->flacDecoder == NULL)
+    goto free_mp3;
+  flacDecoderInit(player->flacDecoder, readStreamChunk, player);
+#endif
+
+  player->aacDecoder = NULL;
+
+#ifdef CONFIG_ENABLE_OPUS
+  if (opusArena != NULL)
+  {
+    uint8_t * const arena = opusArena;
+
+    player->oggReader = opusArena;
+    player->opusDecoder = arena + sizeof(struct OggReader);
+    oggReaderInit(player->oggReader, readStreamChunk, player,
+        arena + sizeof(struct OggReader) + opusStateLength,
+        OPUS_PACKET_LENGTH);
+  }
+  else
+  {
+    player->oggReader = NULL;
+    player->opusDecoder = NULL;
+  }
+#else
+  player->oggReader = NULL;
+  player->opusDecoder = NULL;
+#endif
+
   player->controlCallback = mockControlCallback;
   player->controlCallbackArgument = NULL;
   player->stateCallback = mockStateCallback;
@@ -763,12 +3715,25 @@ bool playerInit(struct Player *player, struct Stream *rx, struct Stream *tx,
   player->tx = tx;
   player->buffers = buffers;
   player->handle = NULL;
+  player->stats.timer = NULL;
+  player->metadata = NULL;
+  player->volume = NULL;
+  player->locations.entries = NULL;
+  player->locations.count = 0;
+  player->resume.pending = false;
+
+  pcmRingInit(&player->pcm.ring, pcmArena, pcmLength);
+  player->pcm.pending = false;
+
+  player->scratch = player->buffer.raw;
+  player->probe = NULL;
 
   player->playback.file = NULL;
+  player->upcoming.file = NULL;
+  player->upcoming.pending = false;
   resetPlayback(player, NULL, 0, NULL);
 
   uint8_t *rxPosition = rxArena;
-  uint8_t *txPosition = txArena;
 
   for (size_t index = 0; index < buffers; ++index)
   {
@@ -780,35 +3745,54 @@ bool playerInit(struct Player *player, struct Stream *rx, struct Stream *tx,
         rxPosition
     };
 
+    /* Buffers of transmit requests point to the decoded data in the ring */
     player->txReq[index] = (struct StreamRequest){
         txLength,
         0,
         onAudioDataSent,
         player,
-        txPosition
+        NULL
     };
+    pointerQueuePushBack(&player->txQueue, &player->txReq[index]);
 
     rxPosition += rxLength;
-    txPosition += txLength;
   }
 
   return true;
 
+#ifdef CONFIG_ENABLE_FLAC
+free_mp3:
+#  ifdef CONFIG_ENABLE_MP3
+  MP3FreeDecoder(player->mp3Decoder);
+#  endif
+#endif
+
 #ifdef CONFIG_ENABLE_MP3
 free_tracks:
+#endif
+#if defined(CONFIG_ENABLE_MP3) || defined(CONFIG_ENABLE_FLAC)
   if (!player->preallocated)
     pathArrayDeinit(&player->tracks);
 #endif
 
+free_queue:
+  pointerQueueDeinit(&player->txQueue);
 free_tx:
   free(player->txReq);
 free_rx:
-  free(player->txReq);
+  free(player->rxReq);
   return false;
 }
 /*----------------------------------------------------------------------------*/
 void playerDeinit(struct Player *player)
 {
+#ifdef CONFIG_ENABLE_AAC
+  if (player->aacDecoder != NULL)
+    AACFreeDecoder(player->aacDecoder);
+#endif
+#ifdef CONFIG_ENABLE_FLAC
+  free(player->flacDecoder);
+#endif
 #ifdef CONFIG_ENABLE_MP3
   MP3FreeDecoder(player->mp3Decoder);
 #endif
@@ -816,6 +3800,7 @@ void playerDeinit(struct Player *player)
   if (!player->preallocated)
     pathArrayDeinit(&player->tracks);
 
+  pointerQueueDeinit(&player->txQueue);
   free(player->txReq);
   free(player->rxReq);
 }
@@ -825,6 +3810,96 @@ size_t playerGetCurrentTrack(const struct Player *player)
   return player->playback.index;
 }
 /*----------------------------------------------------------------------------*/
+struct PlayerStats playerGetStats(const struct Player *player)
+{
+  const uint32_t frequency = player->stats.timer != NULL ?
+      timerGetFrequency(player->stats.timer) : 0;
+  struct PlayerStats stats = {
+      .underruns = player->stats.underruns,
+      .gap = 0,
+      .refill = 0,
+      .load = 0,
+      .peak = 0,
+      .fill = 0,
+      .throughput = 0
+  };
+
+  if (player->stats.requests)
+  {
+    const uint64_t capacity =
+        (uint64_t)player->stats.requests * player->txReq[0].capacity;
+
+    stats.fill = (uint32_t)(100 - player->stats.shortfall * 100 / capacity);
+  }
+
+  if (frequency)
+  {
+    const uint32_t rate = player->playback.info.rate;
+
+    stats.gap = (uint32_t)((uint64_t)player->stats.gap * 1000 / frequency);
+    stats.refill =
+        (uint32_t)((uint64_t)player->stats.refill * 1000 / frequency);
+
+    if (player->stats.frames)
+    {
+      stats.load = (uint32_t)((uint64_t)player->stats.refill * rate * 100
+          / ((uint64_t)player->stats.frames * frequency));
+    }
+
+    if (player->stats.peakFrames)
+    {
+      stats.peak = (uint32_t)((uint64_t)player->stats.peak * rate * 100
+          / ((uint64_t)player->stats.peakFrames * frequency));
+    }
+
+    if (player->stats.reading)
+    {
+      stats.throughput = (uint32_t)((uint64_t)player->stats.bytes
+          * frequency / ((uint64_t)player->stats.reading * 1000));
+    }
+  }
+
+  return stats;
+}
+/*----------------------------------------------------------------------------*/
+uint32_t playerGetDuration(const struct Player *player)
+{
+  return player->playback.info.duration;
+}
+/*----------------------------------------------------------------------------*/
+uint32_t playerGetPosition(const struct Player *player)
+{
+  const struct TrackInfo * const info = &player->playback.info;
+  const uint32_t frequency = info->rate * PCM_FRAME_SIZE;
+  uint64_t decoded = 0;
+
+  if (!frequency)
+    return 0;
+
+  /* Samples of the encoder delay are not played */
+  if (info->sample > info->delay)
+    decoded = (uint64_t)(info->sample - info->delay) * 1000 / info->rate;
+
+  /* Decoded samples waiting in the ring are not played yet */
+  const uint64_t buffered =
+      (uint64_t)pcmRingUsed(&player->pcm.ring) * 1000 / frequency;
+
+  return decoded > buffered ? (uint32_t)(decoded - buffered) : 0;
+}
+/*----------------------------------------------------------------------------*/
+bool playerGetResumePoint(const struct Player *player,
+    struct ResumePoint *point)
+{
+  if (player->playback.file == NULL)
+    return false;
+
+  point->track = hashTrackPath(
+      pathArrayAt(&player->tracks, player->playback.index)->data);
+  point->position = playerGetPosition(player);
+
+  return true;
+}
+/*----------------------------------------------------------------------------*/
 bool playerGetShuffleState(const struct Player *player)
 {
   return player->shuffle;
@@ -846,6 +3921,22 @@ const char *playerGetTrackName(struct Player *player)
     return NULL;
 }
 /*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+/* Returns a text field of the current track or NULL when it is unknown */
+const char *playerGetTrackTag(const struct Player *player,
+    enum MetadataField field)
+{
+  if (player->metadata == NULL)
+    return NULL;
+
+  const struct TrackMetadata * const entry =
+      metadataTableAt(player->metadata, player->playback.index);
+
+  return entry != NULL ?
+      metadataTableGetString(player->metadata, entry, field) : NULL;
+}
+#endif
+/*----------------------------------------------------------------------------*/
 void playerPlayNext(struct Player *player)
 {
   /* Find a next track in the list */
@@ -861,8 +3952,36 @@ void playerPlayPause(struct Player *player)
 {
   if (player->playback.file == NULL)
   {
-    /* Playback was stopped, play from the beginning of the list */
-    playTrack(player, 0, 1);
+    size_t index = 0;
+    uint32_t position = 0;
+
+    if (player->resume.pending)
+    {
+      const size_t count = pathArraySize(&player->tracks);
+
+      /* Track list may be reordered, find the track by its path */
+      for (size_t i = 0; i < count; ++i)
+      {
+        if (hashTrackPath(pathArrayAt(&player->tracks, i)->data)
+            == player->resume.point.track)
+        {
+          index = i;
+          position = player->resume.point.position;
+          break;
+        }
+      }
+
+      player->resume.pending = false;
+    }
+
+    /* Playback was stopped, play from the saved point or from the start */
+    playTrack(player, index, 1);
+
+    if (position && player->playback.file != NULL
+        && player->playback.index == index)
+    {
+      playerSeek(player, position);
+    }
   }
   else
   {
@@ -871,10 +3990,12 @@ void playerPlayPause(struct Player *player)
     if (player->playback.playing)
     {
       player->stateCallback(player->stateCallbackArgument, PLAYER_PLAYING);
-      wqAdd(WQ_DEFAULT, fetchNextChunkTask, player);
+      requestChunkDecoding(player);
     }
     else
     {
+      /* Pause is not a playback gap */
+      player->stats.starving = false;
       player->stateCallback(player->stateCallbackArgument, PLAYER_PAUSED);
     }
   }
@@ -891,11 +4012,61 @@ void playerPlayPrevious(struct Player *player)
   playTrack(player, current - 1, -1);
 }
 /*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+/*
+ * Fills the metadata entry of one track while the playback is stopped, during
+ * the playback the file buffer is used by decoders and entries are filled when
+ * tracks are started. Returns true when more tracks may be waiting.
+ */
+bool playerReadMetadata(struct Player *player)
+{
+  struct MetadataTable * const table = player->metadata;
+
+  if (table == NULL || player->handle == NULL)
+    return false;
+  if (player->playback.file != NULL)
+    return false;
+
+  const size_t count = MIN(pathArraySize(&player->tracks), table->count);
+  size_t index = 0;
+
+  while (index < count && metadataTableAt(table, index) != NULL)
+    ++index;
+
+  if (index == count)
+    return false;
+
+  struct TrackInfo info;
+  struct FsNode * const node = openTrack(player, index, &info);
+
+  if (node != NULL)
+  {
+    updateMetadata(player, node, index, &info);
+    fsNodeFree(node);
+  }
+  else
+  {
+    struct MetadataTags tags;
+
+    /* Unreadable file gets an empty entry, the pass continues */
+    memset(&tags, 0, sizeof(tags));
+    metadataTableStore(table, index, &tags, 0);
+  }
+
+  return index + 1 < count;
+}
+#endif
+/*----------------------------------------------------------------------------*/
 void playerResetFiles(struct Player *player)
 {
   pathArrayClear(&player->tracks);
   resetPlayback(player, NULL, 0, NULL);
   player->handle = NULL;
+  player->volume = NULL;
+  resetLocations(player);
+
+  if (player->metadata != NULL)
+    metadataTableReset(player->metadata);
 }
 /*----------------------------------------------------------------------------*/
 static void scanNodeDescendants(struct Player *player, struct FsNode *root,
@@ -970,6 +4141,11 @@ void playerScanFiles(struct Player *player, struct FsHandle *handle)
   pathArrayClear(&player->tracks);
   resetPlayback(player, NULL, 0, NULL);
 
+  /* Metadata entries are filled later, when tracks are opened or read */
+  if (player->metadata != NULL)
+    metadataTableReset(player->metadata);
+  resetLocations(player);
+
   struct FsNode * const root = fsHandleRoot(handle);
 
   if (root != NULL)
@@ -985,14 +4161,58 @@ void playerScanFiles(struct Player *player, struct FsHandle *handle)
         shuffleTracks(&player->tracks, player->random);
       else
         sortTracks(&player->tracks);
+
+      /* Entries are located once, tracks are opened from them later */
+      locateTracks(player);
     }
   }
   else
     player->handle = NULL;
 }
 /*----------------------------------------------------------------------------*/
+bool playerSeek(struct Player *player, uint32_t time)
+{
+  struct TrackInfo * const info = &player->playback.info;
+
+  if (player->playback.file == NULL || time >= info->duration)
+    return false;
+
+  const IrqState state = irqSave();
+  const bool next = player->playback.next;
+
+  if (!next)
+  {
+    /* Samples that are already sent to the DMA will be played to the end */
+    pcmRingDrop(&player->pcm.ring);
+    player->playback.eof = false;
+  }
+
+  irqRestore(state);
+
+  /* Transition to a next track is already in progress */
+  if (next)
+    return false;
+
+  player->bufferPosition = 0;
+  player->bufferSize = 0;
+
+  const bool ok = info->decoder->seek(player, time);
+
+  if (ok)
+  {
+    if (player->playback.playing)
+      requestChunkDecoding(player);
+  }
+  else
+  {
+    wqAdd(WQ_DEFAULT, abortPlayingTask, player);
+  }
+
+  return ok;
+}
+/*----------------------------------------------------------------------------*/
 void playerSetControlCallback(struct Player *player,
-    void (*callback)(void *, uint32_t, uint8_t), void *argument)
+    void (*callback)(void *, const struct PcmFormat *), void *argument)
 {
   if (callback != NULL)
   {
@@ -1021,6 +4241,54 @@ void playerSetStateCallback(struct Player *player,
   }
 }
 /*----------------------------------------------------------------------------*/
+void playerSetResumePoint(struct Player *player,
+    const struct ResumePoint *point)
+{
+  player->resume.point = *point;
+  player->resume.pending = true;
+}
+/*----------------------------------------------------------------------------*/
+#ifdef CONFIG_ENABLE_METADATA
+/* Table should have an entry for each track of the track list */
+void playerSetMetadataTable(struct Player *player,
+    struct MetadataTable *table)
+{
+  player->metadata = table;
+
+  if (table != NULL)
+    metadataTableReset(table);
+}
+#endif
+/*----------------------------------------------------------------------------*/
+/* Table should have an entry for each track of the track list */
+void playerSetLocationTable(struct Player *player, void *entries,
+    size_t count)
+{
+  player->locations.entries = entries;
+  player->locations.count = entries != NULL ? count : 0;
+  resetLocations(player);
+}
+/*----------------------------------------------------------------------------*/
+/*
+ * Sets a buffer of PLAYER_BUFFER_LENGTH bytes, the next track is opened and
+ * parsed in it before the current track ends. Without the buffer the next
+ * track is opened after all input of the current track is decoded.
+ */
+void playerSetProbeBuffer(struct Player *player, void *buffer)
+{
+  player->probe = buffer;
+}
+/*----------------------------------------------------------------------------*/
+void playerSetStatsTimer(struct Player *player, struct Timer *timer)
+{
+  player->stats.timer = timer;
+}
+/*----------------------------------------------------------------------------*/
+void playerSetVolume(struct Player *player, struct FatVolume *volume)
+{
+  player->volume = volume;
+}
+/*----------------------------------------------------------------------------*/
 void playerShuffleControl(struct Player *player, bool enable)
 {
   assert(!enable || player->random != NULL);
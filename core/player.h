@@ -7,7 +7,14 @@
 #ifndef CORE_PLAYER_H_
 #define CORE_PLAYER_H_
 /*----------------------------------------------------------------------------*/
+#include "adpcm.h"
+#include "fat_extents.h"
+#include "metadata.h"
+#include "pcm_convert.h"
+#include "pcm_ring.h"
+#include "resume.h"
 #include "wav_defs.h"
+#include <xcore/containers/pointer_queue.h>
 #include <xcore/containers/tg_array.h>
 #include <xcore/fs/fs.h>
 #include <xcore/stream.h>
@@ -18,6 +25,16 @@
 #  define TRACK_PATH_LENGTH CONFIG_PATH_LENGTH
 #endif
 
+#define TRACK_TOC_LENGTH 100
+
+/* Number of cached entries of the MP4 sample size table */
+#define MP4_SIZE_CACHE_LENGTH 32
+
+/* Maximum size of decoded data for one MP3 frame */
+#define DECODE_CHUNK_LENGTH (1152 * PCM_FRAME_SIZE)
+/* Length of the file buffer and of the optional probe buffer */
+#define PLAYER_BUFFER_LENGTH 4096
+
 enum [[gnu::packed]] PlayerState
 {
   PLAYER_PLAYING,
@@ -33,8 +50,59 @@ typedef struct
 
 DEFINE_ARRAY(FilePath, Path, path)
 /*----------------------------------------------------------------------------*/
+/* Location of MP4 sample tables in the file */
+struct Mp4Tables
+{
+  /* Position of the sample size table */
+  FsLength sizes;
+  /* Position of the chunk offset table */
+  FsLength chunks;
+  /* Position of the sample-to-chunk table */
+  FsLength map;
+  /* Size of all samples, zero when sizes are stored in the table */
+  uint32_t size;
+  /* Number of samples */
+  uint32_t samples;
+  /* Number of chunks */
+  uint32_t chunkCount;
+  /* Number of sample-to-chunk entries */
+  uint32_t mapCount;
+  /* Chunk offsets are 64-bit values */
+  bool wide;
+};
+
+/* Position of the decoder in MP4 sample tables */
+struct Mp4Cursor
+{
+  /* File position of the next sample */
+  FsLength position;
+  /* File position of the buffered data */
+  FsLength base;
+  /* Index of the next sample */
+  uint32_t sample;
+  /* Index of the current chunk starting from one, zero when not located */
+  uint32_t chunk;
+  /* Samples left in the current chunk */
+  uint32_t left;
+  /* Index of the current sample-to-chunk entry */
+  uint32_t entry;
+  /* First chunk of the next sample-to-chunk entry */
+  uint32_t next;
+  /* Samples per chunk of the current sample-to-chunk entry */
+  uint32_t run;
+  /* Index of the first cached sample size */
+  uint32_t first;
+  /* Number of cached sample sizes */
+  uint32_t cached;
+  /* Cached part of the sample size table */
+  uint32_t sizes[MP4_SIZE_CACHE_LENGTH];
+};
+
 struct TrackInfo
 {
+  /* Decoder of the track, NULL for unsupported files */
+  const struct TrackDecoder *decoder;
+
   /* End-of-file position in bytes */
   FsLength end;
   /* Offset to the audio data in bytes */
@@ -43,15 +111,57 @@ struct TrackInfo
   FsLength position;
   /* Sample rate */
   uint32_t rate;
+  /* Samples to be skipped at the beginning of the stream */
+  uint32_t delay;
+  /* Duration in milliseconds, zero when unknown */
+  uint32_t duration;
+  /* Stream length in samples, zero when unknown */
+  uint32_t length;
+  /* Position in decoded samples */
+  uint32_t sample;
+  /* Serial number of the logical stream in Ogg files */
+  uint32_t serial;
+  /* Size of compressed blocks in bytes, zero for PCM streams */
+  uint16_t block;
+  /* Output gain of Opus streams in 1/256 dB units */
+  int16_t gain;
   /* Channel count */
   uint8_t channels;
-  /* File type */
-  uint8_t type;
+  /* Width of the source samples in bytes */
+  uint8_t width;
+  /* Bits per sample of the source data */
+  uint8_t depth;
+  /* Seek table is available */
+  bool indexed;
+  /* Seek table with file positions for each percent of the duration */
+  uint8_t toc[TRACK_TOC_LENGTH];
+  /* Sample tables of MP4 files */
+  struct Mp4Tables tables;
+  /* Location of the file data on the volume */
+  struct FatExtentMap extents;
+};
+
+struct PlayerStats
+{
+  /* Number of transmit stream underruns */
+  uint32_t underruns;
+  /* Longest playback gap in milliseconds */
+  uint32_t gap;
+  /* Time spent decoding in milliseconds */
+  uint32_t refill;
+  /* Decoding time relative to the duration of decoded audio in percent */
+  uint32_t load;
+  /* Slowest FLAC block decoding time relative to its duration in percent */
+  uint32_t peak;
+  /* Average fill level of transmit requests in percent */
+  uint32_t fill;
+  /* Sustained read speed of the file data in kilobytes per second */
+  uint32_t throughput;
 };
 
 struct Player
 {
-  void (*controlCallback)(void *, uint32_t, uint8_t);
+  void (*controlCallback)(void *, const struct PcmFormat *);
   void *controlCallbackArgument;
   void (*stateCallback)(void *, enum PlayerState);
   void *stateCallbackArgument;
@@ -62,15 +172,33 @@ struct Player
   struct StreamRequest *txReq;
   size_t buffers;
 
+  /* Free transmit requests in the order of completion */
+  PointerQueue txQueue;
+
+  struct
+  {
+    /* Decoded samples waiting for the playback */
+    struct PcmRing ring;
+    /* Stop decoding when the ring level reaches this value */
+    size_t high;
+    /* Resume decoding when the ring level falls below this value */
+    size_t low;
+    /* Decoding task is already in the work queue */
+    bool pending;
+  } pcm;
+
   struct FsHandle *handle;
   PathArray tracks;
 
   /* File buffer */
   union
   {
-    uint8_t raw[4096];
-    struct WavHeader wav;
+    uint8_t raw[PLAYER_BUFFER_LENGTH];
   } buffer;
+  /* Buffer for stream headers, the file buffer or the probe buffer */
+  uint8_t *scratch;
+  /* Buffer for opening the next track during the playback, optional */
+  uint8_t *probe;
 
   /* Position from the beginning of the buffer in bytes */
   size_t bufferPosition;
@@ -88,12 +216,91 @@ struct Player
     bool playing;
     /* Stop playing request */
     bool stop;
+    /* All audio data of the current file is decoded */
+    bool eof;
+    /* Next track is requested */
+    bool next;
 
     struct TrackInfo info;
   } playback;
 
+  /* Next track opened in advance */
+  struct
+  {
+    struct FsNode *file;
+    size_t index;
+    struct TrackInfo info;
+
+    /* Opening task is already in the work queue */
+    bool pending;
+    /* Opening was attempted during the current track */
+    bool checked;
+  } upcoming;
+
+  /* Saved playback position */
+  struct
+  {
+    struct ResumePoint point;
+    /* Position is used on the next start of the playback */
+    bool pending;
+  } resume;
+
+  /* Playback statistics of the current track */
+  struct
+  {
+    /* Timer for time measurements, optional */
+    struct Timer *timer;
+    /* Time of the last underrun in timer ticks */
+    uint32_t timestamp;
+    /* Longest playback gap in timer ticks */
+    uint32_t gap;
+    /* Time spent decoding in timer ticks */
+    uint32_t refill;
+    /* Number of decoded frames */
+    uint32_t frames;
+    /* Decoding time of the slowest block in timer ticks */
+    uint32_t peak;
+    /* Length of the slowest block in frames */
+    uint32_t peakFrames;
+    /* Number of transmit requests */
+    uint32_t requests;
+    /* Unused space of transmit requests in bytes */
+    uint32_t shortfall;
+    /* Bytes read from the file */
+    uint32_t bytes;
+    /* Time spent reading the file in timer ticks */
+    uint32_t reading;
+    /* Number of transmit stream underruns */
+    uint32_t underruns;
+    /* Transmit stream has no queued requests */
+    bool starving;
+  } stats;
+
+  /* Direct access to the volume with track files, optional */
+  struct FatVolume *volume;
+  /* Directory entry locations of tracks, optional */
+  struct
+  {
+    struct FatLocation *entries;
+    size_t count;
+  } locations;
+  /* Metadata side table of the track list, optional */
+  struct MetadataTable *metadata;
+
+  /* IMA ADPCM decoder state */
+  struct AdpcmDecoder adpcm;
   /* Helix MP3 decoder instance */
   void *mp3Decoder;
+  /* Helix AAC decoder instance, it replaces the MP3 decoder during playback */
+  void *aacDecoder;
+  /* Position in sample tables of the current MP4 track */
+  struct Mp4Cursor mp4;
+  /* FLAC decoder instance */
+  struct FlacDecoder *flacDecoder;
+  /* Opus decoder state placed in the preallocated arena */
+  void *opusDecoder;
+  /* Ogg page reader placed in the preallocated arena */
+  struct OggReader *oggReader;
   /* Random number generation function */
   int (*random)(void);
   /* Track buffer is preallocated */
@@ -105,21 +312,37 @@ struct Player
 BEGIN_DECLS
 
 bool playerInit(struct Player *, struct Stream *, struct Stream *,
-    size_t, size_t, size_t, size_t, void *, void *, void *, int (*)(void));
+    size_t, size_t, size_t, size_t, size_t, size_t, void *, void *, void *,
+    void *, int (*)(void));
 void playerDeinit(struct Player *);
 size_t playerGetCurrentTrack(const struct Player *);
+uint32_t playerGetDuration(const struct Player *);
+uint32_t playerGetPosition(const struct Player *);
+bool playerGetResumePoint(const struct Player *, struct ResumePoint *);
 bool playerGetShuffleState(const struct Player *);
+struct PlayerStats playerGetStats(const struct Player *);
 size_t playerGetTrackCount(const struct Player *);
 const char *playerGetTrackName(struct Player *);
+#ifdef CONFIG_ENABLE_METADATA
+const char *playerGetTrackTag(const struct Player *, enum MetadataField);
+bool playerReadMetadata(struct Player *);
+void playerSetMetadataTable(struct Player *, struct MetadataTable *);
+#endif
 void playerPlayNext(struct Player *);
 void playerPlayPause(struct Player *);
 void playerPlayPrevious(struct Player *);
 void playerResetFiles(struct Player *);
 void playerScanFiles(struct Player *, struct FsHandle *);
+bool playerSeek(struct Player *, uint32_t);
 void playerSetControlCallback(struct Player *,
-    void (*)(void *, uint32_t, uint8_t), void *);
+    void (*)(void *, const struct PcmFormat *), void *);
 void playerSetStateCallback(struct Player *,
     void (*)(void *, enum PlayerState), void *);
+void playerSetResumePoint(struct Player *, const struct ResumePoint *);
+void playerSetLocationTable(struct Player *, void *, size_t);
+void playerSetProbeBuffer(struct Player *, void *);
+void playerSetStatsTimer(struct Player *, struct Timer *);
+void playerSetVolume(struct Player *, struct FatVolume *);
 void playerShuffleControl(struct Player *, bool);
 void playerStopPlaying(struct Player *);
 
@@ -0,0 +1,137 @@
+/*
+ * core/resume.c
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#include "resume.h"
+#include <xcore/memory.h>
+#include <stddef.h>
+/*----------------------------------------------------------------------------*/
+#define RECORD_MAGIC 0x52534D50UL
+
+struct [[gnu::packed]] ResumeRecord
+{
+  uint32_t sequence;
+  uint32_t track;
+  uint32_t position;
+  uint32_t checksum;
+};
+/*----------------------------------------------------------------------------*/
+static uint32_t calcRecordChecksum(const struct ResumeRecord *);
+static bool readRecord(struct ResumeStorage *, size_t, struct ResumeRecord *);
+static bool writeRecord(struct ResumeStorage *, size_t,
+    const struct ResumeRecord *);
+/*----------------------------------------------------------------------------*/
+static uint32_t calcRecordChecksum(const struct ResumeRecord *record)
+{
+  const uint8_t * const data = (const uint8_t *)record;
+  uint32_t hash = 0x811C9DC5UL ^ RECORD_MAGIC;
+
+  /* FNV-1a hash of all fields except the checksum itself */
+  for (size_t i = 0; i < offsetof(struct ResumeRecord, checksum); ++i)
+  {
+    hash ^= data[i];
+    hash *= 0x01000193UL;
+  }
+
+  return hash;
+}
+/*----------------------------------------------------------------------------*/
+static bool readRecord(struct ResumeStorage *storage, size_t slot,
+    struct ResumeRecord *record)
+{
+  const uint32_t position = (uint32_t)(slot * sizeof(struct ResumeRecord));
+
+  if (ifSetParam(storage->memory, IF_POSITION, &position) != E_OK)
+    return false;
+  if (ifRead(storage->memory, record, sizeof(*record)) != sizeof(*record))
+    return false;
+
+  return fromLittleEndian32(record->checksum) == calcRecordChecksum(record);
+}
+/*----------------------------------------------------------------------------*/
+static bool writeRecord(struct ResumeStorage *storage, size_t slot,
+    const struct ResumeRecord *record)
+{
+  const uint32_t position = (uint32_t)(slot * sizeof(struct ResumeRecord));
+
+  if (ifSetParam(storage->memory, IF_POSITION, &position) != E_OK)
+    return false;
+
+  return ifWrite(storage->memory, record, sizeof(*record)) == sizeof(*record);
+}
+/*----------------------------------------------------------------------------*/
+bool resumeStorageInit(struct ResumeStorage *storage, struct Interface *memory)
+{
+  uint32_t size;
+
+  if (ifGetParam(memory, IF_SIZE, &size) != E_OK)
+    return false;
+
+  storage->memory = memory;
+  storage->capacity = size / sizeof(struct ResumeRecord);
+  storage->slot = 0;
+  storage->sequence = 0;
+  storage->last = (struct ResumePoint){0, 0};
+
+  return storage->capacity > 0;
+}
+/*----------------------------------------------------------------------------*/
+bool resumeStorageLoad(struct ResumeStorage *storage,
+    struct ResumePoint *point)
+{
+  bool found = false;
+
+  for (size_t slot = 0; slot < storage->capacity; ++slot)
+  {
+    struct ResumeRecord record;
+
+    if (!readRecord(storage, slot, &record))
+      continue;
+
+    const uint32_t sequence = fromLittleEndian32(record.sequence);
+
+    if (!found || sequence > storage->sequence)
+    {
+      found = true;
+
+      storage->last.track = fromLittleEndian32(record.track);
+      storage->last.position = fromLittleEndian32(record.position);
+      storage->sequence = sequence;
+      storage->slot = slot + 1 < storage->capacity ? slot + 1 : 0;
+    }
+  }
+
+  if (found)
+    *point = storage->last;
+
+  return found;
+}
+/*----------------------------------------------------------------------------*/
+bool resumeStorageSave(struct ResumeStorage *storage,
+    const struct ResumePoint *point)
+{
+  /* Memory is not written when nothing has changed */
+  if (storage->sequence && point->track == storage->last.track
+      && point->position == storage->last.position)
+  {
+    return true;
+  }
+
+  struct ResumeRecord record = {
+      .sequence = toLittleEndian32(storage->sequence + 1),
+      .track = toLittleEndian32(point->track),
+      .position = toLittleEndian32(point->position)
+  };
+  record.checksum = toLittleEndian32(calcRecordChecksum(&record));
+
+  if (!writeRecord(storage, storage->slot, &record))
+    return false;
+
+  ++storage->sequence;
+  storage->last = *point;
+  storage->slot = storage->slot + 1 < storage->capacity ? storage->slot + 1 : 0;
+
+  return true;
+}
@@ -0,0 +1,47 @@
+/*
+ * core/resume.h
+ * Copyright (C) 2025 xent
+ * Project is distributed under the terms of the GNU General Public License v3.0
+ */
+
+#ifndef CORE_RESUME_H_
+#define CORE_RESUME_H_
+/*----------------------------------------------------------------------------*/
+#include <xcore/interface.h>
+#include <stdint.h>
+/*----------------------------------------------------------------------------*/
+struct ResumePoint
+{
+  /* Hash of the track path */
+  uint32_t track;
+  /* Position in milliseconds */
+  uint32_t position;
+};
+
+/*
+ * Resume points are stored as a log of fixed-size records. Each new record
+ * is written to the next slot, so the wear is spread over the whole memory.
+ */
+struct ResumeStorage
+{
+  struct Interface *memory;
+
+  /* Last stored resume point */
+  struct ResumePoint last;
+  /* Number of record slots */
+  size_t capacity;
+  /* Next slot to be written */
+  size_t slot;
+  /* Sequence number of the last record */
+  uint32_t sequence;
+};
+/*----------------------------------------------------------------------------*/
+BEGIN_DECLS
+
+bool resumeStorageInit(struct ResumeStorage *, struct Interface *);
+bool resumeStorageLoad(struct ResumeStorage *, struct ResumePoint *);
+bool resumeStorageSave(struct ResumeStorage *, const struct ResumePoint *);
+
+END_DECLS
+/*----------------------------------------------------------------------------*/
+#endif /* CORE_RESUME_H_ */
@@ -9,26 +9,58 @@
 /*----------------------------------------------------------------------------*/
 #include <stdint.h>
 /*----------------------------------------------------------------------------*/
-struct [[gnu::packed]] WavHeader
+enum
 {
-  /* The "RIFF" chunk */
-  uint32_t chunkId;
-  uint32_t chunkSize;
+  RIFF_ID_RIFF  = 0x52494646UL,
+  RIFF_ID_WAVE  = 0x57415645UL,
+  RIFF_ID_DATA  = 0x64617461UL,
+  RIFF_ID_FMT   = 0x666D7420UL,
+  RIFF_ID_INFO  = 0x494E464FUL,
+  RIFF_ID_LIST  = 0x4C495354UL
+};
+
+enum
+{
+  WAVE_FORMAT_PCM         = 0x0001,
+  WAVE_FORMAT_IMA_ADPCM   = 0x0011,
+  WAVE_FORMAT_EXTENSIBLE  = 0xFFFE
+};
+
+/* The "RIFF" header at the beginning of the file */
+struct [[gnu::packed]] RiffHeader
+{
+  uint32_t id;
+  uint32_t size;
   uint32_t format;
+};
 
-  /* The "fmt" subchunk */
-  uint32_t subchunk1Id;
-  uint32_t subchunk1Size;
+/* Header of each chunk, chunk data is padded to an even size */
+struct [[gnu::packed]] RiffChunk
+{
+  uint32_t id;
+  uint32_t size;
+};
+
+/* Data of the "fmt " chunk */
+struct [[gnu::packed]] WavFormat
+{
   uint16_t audioFormat;
   uint16_t numChannels;
   uint32_t sampleRate;
   uint32_t byteRate;
   uint16_t blockAlign;
   uint16_t bitsPerSample;
+};
 
-  /* The "data" subchunk */
-  uint32_t subchunk2Id;
-  uint32_t subchunk2Size;
+/* Data of the "fmt " chunk with the WAVE_FORMAT_EXTENSIBLE format */
+struct [[gnu::packed]] WavFormatExtensible
+{
+  struct WavFormat base;
+  uint16_t extensionSize;
+  uint16_t validBitsPerSample;
+  uint32_t channelMask;
+  /* GUID, first two bytes contain the format code */
+  uint8_t subFormat[16];
 };
 /*----------------------------------------------------------------------------*/
 #endif /* CORE_WAV_DEFS_H_ */